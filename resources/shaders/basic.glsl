@@ -5,13 +5,22 @@
  * ==================================== */
 #ifdef COMPILING_VERTEX
 
-layout (location = 0) in vec3 att_position;
-layout (location = 1) in vec3 att_tex_coords_layer;
-layout (location = 2) in vec3 att_normal;
+// See Vertex_Chunk: xyz is the position relative to the chunk and w is the face direction.
+layout (location = 0) in uvec4 att_position_face;
+layout (location = 1) in uvec2 att_tex_coords;
+layout (location = 2) in uint att_layer;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 light_space;
+uniform vec3 chunk_origin;
+
+// Indexed by BlockFace.
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3(-1, 0, 0), vec3(1, 0, 0),
+    vec3(0, 1, 0), vec3(0, -1, 0),
+    vec3(0, 0, 1), vec3(0, 0, -1)
+);
 
 out VS_OUT
 {
@@ -25,12 +34,14 @@ out VS_OUT
 void
 main()
 {
-    vs_out.frag_world_pos = att_position;
-    vs_out.frag_tex_coords_layer = att_tex_coords_layer;
-    vs_out.frag_normal = att_normal;
+    vec3 world_pos = chunk_origin + vec3(att_position_face.xyz);
+
+    vs_out.frag_world_pos = world_pos;
+    vs_out.frag_tex_coords_layer = vec3(vec2(att_tex_coords), float(att_layer));
+    vs_out.frag_normal = FACE_NORMALS[att_position_face.w];
     vs_out.frag_pos_light_space = light_space * vec4(vs_out.frag_world_pos, 1.0f);
 
-    vec4 pos_in_camera_space = view * vec4(att_position, 1.0);
+    vec4 pos_in_camera_space = view * vec4(world_pos, 1.0);
 
     const float density = 0.010;
     const float gradient = 2.0;
@@ -5,15 +5,17 @@
  * ==================================== */
 #ifdef COMPILING_VERTEX
 
-layout (location = 0) in vec3 att_position;
+// See Vertex_Chunk: xyz is the position relative to the chunk and w is the face direction.
+layout (location = 0) in uvec4 att_position_face;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform vec3 chunk_origin;
 
 void
 main()
 {
-    gl_Position = projection * view * vec4(att_position, 1.0f);
+    gl_Position = projection * view * vec4(chunk_origin + vec3(att_position_face.xyz), 1.0f);
 }
 
 #endif
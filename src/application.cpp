@@ -183,7 +183,8 @@ Application::process_input()
             GLFW_KEY_D, GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT,
             GLFW_KEY_ENTER,
             // Key codes used for debugging functionality.
-            GLFW_KEY_F5, GLFW_KEY_F6, GLFW_KEY_T
+            GLFW_KEY_F3, GLFW_KEY_F4, GLFW_KEY_F5, GLFW_KEY_F6, GLFW_KEY_F7, GLFW_KEY_F8,
+            GLFW_KEY_F9, GLFW_KEY_F10, GLFW_KEY_F11, GLFW_KEY_F12, GLFW_KEY_T
         };
 
         for (auto key_code : key_codes)
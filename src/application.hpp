@@ -13,8 +13,10 @@ struct Memory
 {
     Memory()
         // This memory is used with a pool allocator.
-        : chunks_memory_size(sizeof(Landscape::Chunk) * Landscape::NUM_CHUNKS)
+        : chunks_memory_size(sizeof(Landscape::Chunk) * (Landscape::MAX_CHUNKS + Landscape::MAX_EVICTED_CHUNKS))
         , chunks_memory(calloc(1, chunks_memory_size))
+        // Maximum memory used by the cache of chunk meshes.
+        , mesh_cache_size(32 * 1024 * 1024)
     {}
 
     ~Memory()
@@ -25,6 +27,7 @@ struct Memory
 public:
     usize chunks_memory_size;
     void *chunks_memory;
+    usize mesh_cache_size;
 };
 
 struct Application
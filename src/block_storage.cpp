@@ -0,0 +1,154 @@
+#include "block_storage.hpp"
+
+BlockStorage::BlockStorage(BlockType fill_type)
+{
+    fill(fill_type);
+}
+
+i32
+BlockStorage::bits_for_palette_size(i32 palette_size)
+{
+    if (palette_size <= 1) return 0;
+    if (palette_size <= 2) return 1;
+    if (palette_size <= 4) return 2;
+    if (palette_size <= MAX_PALETTE_SIZE) return 4;
+    return 8;
+}
+
+void
+BlockStorage::fill(BlockType type)
+{
+    m_bits_per_index = 0;
+    m_palette_size = 1;
+    m_palette[0] = type;
+    m_words.clear();
+    m_words.shrink_to_fit();
+}
+
+void
+BlockStorage::set(i32 x, i32 y, i32 z, BlockType type)
+{
+    i32 index = -1;
+    if (m_bits_per_index == 8)
+    {
+        index = type;
+    }
+    else
+    {
+        for (i32 i = 0; i < m_palette_size; i++)
+            if (m_palette[i] == type) index = i;
+    }
+
+    if (index == -1)
+    {
+        // The type is not in the palette yet, so the indices may need more bits.
+        const i32 bits_per_index = bits_for_palette_size(m_palette_size + 1);
+        if (bits_per_index != m_bits_per_index)
+            repack(bits_per_index);
+
+        if (m_bits_per_index == 8)
+        {
+            index = type;
+        }
+        else
+        {
+            index = m_palette_size++;
+            m_palette[index] = type;
+        }
+    }
+
+    if (m_bits_per_index > 0)
+        set_index(block_index(x, y, z), index);
+}
+
+void
+BlockStorage::get_row_z(i32 x, i32 y, BlockType row[NUM_BLOCKS_PER_AXIS]) const
+{
+    if (m_bits_per_index == 0)
+    {
+        for (i32 z = 0; z < NUM_BLOCKS_PER_AXIS; z++)
+            row[z] = m_palette[0];
+        return;
+    }
+
+    const i32 first = block_index(x, y, 0);
+    for (i32 z = 0; z < NUM_BLOCKS_PER_AXIS; z++)
+    {
+        const u32 index = get_index(first + z);
+        row[z] = (m_bits_per_index == 8) ? static_cast<BlockType>(index) : m_palette[index];
+    }
+}
+
+void
+BlockStorage::assign(const BlockType blocks[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS])
+{
+    const BlockType *first = &blocks[0][0][0];
+
+    m_palette_size = 0;
+    for (i32 i = 0; i < NUM_BLOCKS; i++)
+    {
+        bool is_in_palette = false;
+        for (i32 p = 0; p < m_palette_size && !is_in_palette; p++)
+            is_in_palette = (m_palette[p] == first[i]);
+
+        if (is_in_palette)
+            continue;
+        if (m_palette_size == MAX_PALETTE_SIZE)
+        {
+            m_palette_size++;
+            break;
+        }
+        m_palette[m_palette_size++] = first[i];
+    }
+
+    if (m_palette_size == 1)
+    {
+        fill(m_palette[0]);
+        return;
+    }
+
+    m_bits_per_index = bits_for_palette_size(m_palette_size);
+    store(first);
+}
+
+void
+BlockStorage::repack(i32 bits_per_index)
+{
+    BlockType blocks[NUM_BLOCKS];
+    for (i32 x = 0; x < NUM_BLOCKS_PER_AXIS; x++)
+        for (i32 y = 0; y < NUM_BLOCKS_PER_AXIS; y++)
+            get_row_z(x, y, &blocks[block_index(x, y, 0)]);
+
+    m_bits_per_index = bits_per_index;
+    store(blocks);
+}
+
+void
+BlockStorage::store(const BlockType *blocks)
+{
+    LT_Assert(m_bits_per_index > 0);
+
+    m_words.assign(NUM_BLOCKS * m_bits_per_index / BITS_PER_WORD, 0);
+    m_words.shrink_to_fit();
+
+    if (m_bits_per_index == 8)
+    {
+        for (i32 i = 0; i < NUM_BLOCKS; i++)
+            set_index(i, blocks[i]);
+        return;
+    }
+
+    // NOTE: Neighboring blocks are usually the same, so the palette index of the last block is
+    // checked first.
+    u32 index = 0;
+    for (i32 i = 0; i < NUM_BLOCKS; i++)
+    {
+        if (m_palette[index] != blocks[i])
+        {
+            index = 0;
+            while (m_palette[index] != blocks[i]) index++;
+            LT_Assert((i32)index < m_palette_size);
+        }
+        set_index(i, index);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __BLOCK_STORAGE_HPP__
+#define __BLOCK_STORAGE_HPP__
+
+#include <vector>
+#include "lt_core.hpp"
+
+enum BlockType : u8
+{
+    BlockType_Air,
+    BlockType_Terrain,
+    BlockType_Count,
+};
+
+//
+// Blocks of a chunk, stored as indices into a palette with the block types used by the chunk.
+// Each index only takes as many bits as the palette needs, so a chunk made of air and terrain
+// takes 512 bytes, and a chunk with a single block type does not store any index at all. Chunks
+// with more than MAX_PALETTE_SIZE block types store one byte per block with the type itself.
+//
+struct BlockStorage
+{
+    constexpr static i32 NUM_BLOCKS_PER_AXIS = 16;
+    constexpr static i32 NUM_BLOCKS = NUM_BLOCKS_PER_AXIS*NUM_BLOCKS_PER_AXIS*NUM_BLOCKS_PER_AXIS;
+    constexpr static i32 MAX_PALETTE_SIZE = 16;
+
+    explicit BlockStorage(BlockType fill_type = BlockType_Air);
+
+    inline BlockType get(i32 x, i32 y, i32 z) const
+    {
+        if (m_bits_per_index == 0)
+            return m_palette[0];
+
+        const u32 index = get_index(block_index(x, y, z));
+        return (m_bits_per_index == 8) ? static_cast<BlockType>(index) : m_palette[index];
+    }
+
+    void set(i32 x, i32 y, i32 z, BlockType type);
+    // Replaces every block by the same type, releasing the memory of the indices.
+    void fill(BlockType type);
+    // Replaces every block, choosing the smallest palette for them.
+    void assign(const BlockType blocks[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]);
+    // Writes the blocks from (x, y, 0) to (x, y, NUM_BLOCKS_PER_AXIS-1).
+    void get_row_z(i32 x, i32 y, BlockType row[NUM_BLOCKS_PER_AXIS]) const;
+
+    inline bool is_uniform() const { return m_bits_per_index == 0; }
+    inline i32 bits_per_index() const { return m_bits_per_index; }
+    // Bytes taken by the indices, without counting the storage object itself.
+    inline usize index_bytes() const { return m_words.size() * sizeof(u64); }
+
+private:
+    constexpr static i32 BITS_PER_WORD = 64;
+
+    inline static i32 block_index(i32 x, i32 y, i32 z)
+    {
+        LT_Assert(x >= 0 && x < NUM_BLOCKS_PER_AXIS);
+        LT_Assert(y >= 0 && y < NUM_BLOCKS_PER_AXIS);
+        LT_Assert(z >= 0 && z < NUM_BLOCKS_PER_AXIS);
+        return (x*NUM_BLOCKS_PER_AXIS + y)*NUM_BLOCKS_PER_AXIS + z;
+    }
+
+    // NOTE: The number of bits per index always divides 64, so an index never spans two words.
+    inline u32 get_index(i32 i) const
+    {
+        const u32 bit = i * m_bits_per_index;
+        const u64 mask = (1ull << m_bits_per_index) - 1;
+        return (m_words[bit / BITS_PER_WORD] >> (bit % BITS_PER_WORD)) & mask;
+    }
+
+    inline void set_index(i32 i, u32 index)
+    {
+        const u32 bit = i * m_bits_per_index;
+        const u64 mask = (1ull << m_bits_per_index) - 1;
+        u64 &word = m_words[bit / BITS_PER_WORD];
+        word = (word & ~(mask << (bit % BITS_PER_WORD))) | ((u64)index << (bit % BITS_PER_WORD));
+    }
+
+    // Stores the blocks again with a different number of bits per index.
+    void repack(i32 bits_per_index);
+    void store(const BlockType *blocks);
+
+    static i32 bits_for_palette_size(i32 palette_size);
+
+private:
+    // Either 0, 1, 2, 4 or 8 bits. With 8 bits the indices are the block types themselves.
+    i32              m_bits_per_index;
+    i32              m_palette_size;
+    BlockType        m_palette[MAX_PALETTE_SIZE];
+    std::vector<u64> m_words;
+};
+
+#endif // __BLOCK_STORAGE_HPP__
@@ -0,0 +1,525 @@
+#include "chunk_mesher.hpp"
+#include "world.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Offset to the neighbor block that touches each of the faces, indexed by BlockFace.
+lt_global_variable const i32 FACE_NEIGHBOR_OFFSETS[BlockFace_Count][3] = {
+    {-1, 0, 0}, // Left
+    { 1, 0, 0}, // Right
+    { 0, 1, 0}, // Top
+    { 0,-1, 0}, // Bottom
+    { 0, 0, 1}, // Front
+    { 0, 0,-1}, // Back
+};
+
+lt_internal inline bool
+is_face_visible(const PaddedChunk &padded, i32 px, i32 py, i32 pz, BlockFace face)
+{
+    const i32 *offset = FACE_NEIGHBOR_OFFSETS[face];
+    return !padded.is_solid(px + offset[0], py + offset[1], pz + offset[2]);
+}
+
+lt_internal inline u16
+get_face_layer(i32 aby, BlockFace face, bool should_render_top_face)
+{
+    // TODO: Figure out a better way of mixing and matching different
+    // block textures.
+    const bool is_snow = aby > Landscape::TOTAL_BLOCKS_Y - 30;
+    switch (face)
+    {
+    case BlockFace_Top:
+        return is_snow ? Textures16x16_Snow_Top : Textures16x16_Earth_Top;
+    case BlockFace_Bottom:
+        return is_snow ? Textures16x16_Snow_Bottom : Textures16x16_Earth_Bottom;
+    default:
+        if (is_snow)
+            return should_render_top_face ? Textures16x16_Snow_Sides_Top : Textures16x16_Snow_Sides;
+        else
+            return should_render_top_face ? Textures16x16_Earth_Sides_Top : Textures16x16_Earth_Sides;
+    }
+}
+
+lt_internal void
+make_face_quad(Vertex_Chunk quad[4], i32 bx, i32 by, i32 bz,
+               i32 size_x, i32 size_y, i32 size_z, BlockFace face, u16 layer)
+{
+    // The quad covers the given face of the box that starts at block (bx, by, bz),
+    // all coordinates being relative to the chunk origin.
+    const u8 x0 = bx, x1 = bx + size_x;
+    const u8 y0 = by, y1 = by + size_y;
+    const u8 z0 = bz, z1 = bz + size_z;
+
+    // Corners of the quad following its texture coordinates: c00 -> (0, 0), c10 -> (w, 0) and so on.
+    Vec3i c00, c10, c11, c01;
+    u8 w, h;
+
+    switch (face)
+    {
+    case BlockFace_Left:
+        c00 = Vec3i(x0, y0, z0); c10 = Vec3i(x0, y0, z1);
+        c11 = Vec3i(x0, y1, z1); c01 = Vec3i(x0, y1, z0);
+        w = size_z; h = size_y;
+        break;
+    case BlockFace_Right:
+        c00 = Vec3i(x1, y0, z0); c10 = Vec3i(x1, y0, z1);
+        c11 = Vec3i(x1, y1, z1); c01 = Vec3i(x1, y1, z0);
+        w = size_z; h = size_y;
+        break;
+    case BlockFace_Top:
+        c00 = Vec3i(x0, y1, z1); c10 = Vec3i(x1, y1, z1);
+        c11 = Vec3i(x1, y1, z0); c01 = Vec3i(x0, y1, z0);
+        w = size_x; h = size_z;
+        break;
+    case BlockFace_Bottom:
+        c00 = Vec3i(x0, y0, z0); c10 = Vec3i(x1, y0, z0);
+        c11 = Vec3i(x1, y0, z1); c01 = Vec3i(x0, y0, z1);
+        w = size_x; h = size_z;
+        break;
+    case BlockFace_Front:
+        c00 = Vec3i(x0, y0, z1); c10 = Vec3i(x1, y0, z1);
+        c11 = Vec3i(x1, y1, z1); c01 = Vec3i(x0, y1, z1);
+        w = size_x; h = size_y;
+        break;
+    case BlockFace_Back:
+        c00 = Vec3i(x1, y0, z0); c10 = Vec3i(x0, y0, z0);
+        c11 = Vec3i(x0, y1, z0); c01 = Vec3i(x1, y1, z0);
+        w = size_x; h = size_y;
+        break;
+    default:
+        LT_Unreachable;
+    }
+
+    const Vertex_Chunk v00(c00, face, 0, 0, layer);
+    const Vertex_Chunk v10(c10, face, w, 0, layer);
+    const Vertex_Chunk v11(c11, face, w, h, layer);
+    const Vertex_Chunk v01(c01, face, 0, h, layer);
+
+    // Vertices are indexed as (0, 1, 2) (2, 3, 0) by the shared quad index buffer.
+    // The right face is the only one where the corners have to be visited in the opposite
+    // order in order to keep a counter clockwise winding.
+    if (face == BlockFace_Right)
+    {
+        quad[0] = v00;
+        quad[1] = v01;
+        quad[2] = v11;
+        quad[3] = v10;
+    }
+    else
+    {
+        quad[0] = v00;
+        quad[1] = v10;
+        quad[2] = v11;
+        quad[3] = v01;
+    }
+}
+
+lt_internal void
+push_face_quad(ChunkVertexBuffer &vertices, i32 bx, i32 by, i32 bz,
+               i32 size_x, i32 size_y, i32 size_z, BlockFace face, u16 layer)
+{
+    Vertex_Chunk quad[4];
+    make_face_quad(quad, bx, by, bz, size_x, size_y, size_z, face, layer);
+    vertices.insert(vertices.end(), quad, quad + 4);
+}
+
+void
+mesh_chunk_naive(const PaddedChunk &padded, ChunkVertexBuffer &vertices)
+{
+    for (i32 face_index = 0; face_index < BlockFace_Count; face_index++)
+    {
+        const BlockFace face = static_cast<BlockFace>(face_index);
+
+        for (i32 bx = 0; bx < Landscape::Chunk::NUM_BLOCKS_PER_AXIS; bx++)
+            for (i32 by = 0; by < Landscape::Chunk::NUM_BLOCKS_PER_AXIS; by++)
+                for (i32 bz = 0; bz < Landscape::Chunk::NUM_BLOCKS_PER_AXIS; bz++)
+                {
+                    // Indexes of the block in the padded chunk.
+                    const i32 px = bx + 1;
+                    const i32 py = by + 1;
+                    const i32 pz = bz + 1;
+
+                    if (!padded.is_solid(px, py, pz) || !is_face_visible(padded, px, py, pz, face))
+                        continue;
+
+                    const i32 aby = padded.base_aby + by;
+                    const bool should_render_top_face =
+                        (face == BlockFace_Top) || is_face_visible(padded, px, py, pz, BlockFace_Top);
+
+                    push_face_quad(vertices, bx, by, bz, 1, 1, 1, face,
+                                   get_face_layer(aby, face, should_render_top_face));
+                }
+    }
+}
+
+void
+downsample_padded_chunk(PaddedChunk &padded, i32 lod, Landscape::LodDownsampling downsampling)
+{
+    constexpr i32 N = Landscape::Chunk::NUM_BLOCKS_PER_AXIS;
+    const i32 cell_size = 1 << lod;
+    LT_Assert(cell_size <= N);
+
+    if (lod == 0)
+        return;
+
+    for (i32 cx = 0; cx < N; cx += cell_size)
+        for (i32 cy = 0; cy < N; cy += cell_size)
+            for (i32 cz = 0; cz < N; cz += cell_size)
+            {
+                i32 type_counts[BlockType_Count] = {};
+                for (i32 x = cx; x < cx + cell_size; x++)
+                    for (i32 y = cy; y < cy + cell_size; y++)
+                        for (i32 z = cz; z < cz + cell_size; z++)
+                            type_counts[padded.blocks[x+1][y+1][z+1]]++;
+
+                // The cell takes the most common solid type of its blocks.
+                u8 cell_type = BlockType_Air;
+                i32 cell_type_count = 0;
+                for (i32 type = BlockType_Air + 1; type < BlockType_Count; type++)
+                    if (type_counts[type] > cell_type_count)
+                    {
+                        cell_type = type;
+                        cell_type_count = type_counts[type];
+                    }
+
+                const i32 num_solid = cell_size*cell_size*cell_size - type_counts[BlockType_Air];
+                if (downsampling == Landscape::LodDownsampling_Majority && 2*num_solid < cell_size*cell_size*cell_size)
+                    cell_type = BlockType_Air;
+
+                for (i32 x = cx; x < cx + cell_size; x++)
+                    for (i32 y = cy; y < cy + cell_size; y++)
+                        for (i32 z = cz; z < cz + cell_size; z++)
+                            padded.blocks[x+1][y+1][z+1] = cell_type;
+            }
+
+    // The rows that go through the inside of the chunk have to follow the new blocks.
+    for (i32 i = 1; i <= N; i++)
+        for (i32 j = 1; j <= N; j++)
+        {
+            u16 row_x = 0;
+            u16 row_z = 0;
+            for (i32 k = 0; k < N; k++)
+            {
+                if (padded.is_solid(k+1, i, j)) row_x |= (1 << k);
+                if (padded.is_solid(i, j, k+1)) row_z |= (1 << k);
+            }
+            padded.occupancy_x[i][j] = row_x;
+            padded.occupancy_z[i][j] = row_z;
+        }
+}
+
+void
+count_face_quads(const ChunkVertexBuffer &vertices, u32 face_num_quads[BlockFace_Count])
+{
+    for (i32 face = 0; face < BlockFace_Count; face++)
+        face_num_quads[face] = 0;
+
+    for (usize vertex = 0; vertex < vertices.size(); vertex += 4)
+    {
+        LT_Assert(vertex == 0 || vertices[vertex].face >= vertices[vertex-4].face);
+        face_num_quads[vertices[vertex].face]++;
+    }
+}
+
+void
+mesh_chunk_greedy(const PaddedChunk &padded, ChunkVertexBuffer &vertices)
+{
+    // NOTE: This is the greedy meshing algorithm described in
+    // https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/
+    // Every slice of the chunk is swept once for each face direction, and visible faces
+    // with the same texture layer are grown into rectangles, first along u and then along v.
+    constexpr i32 N = Landscape::Chunk::NUM_BLOCKS_PER_AXIS;
+
+    // Which block axes (0 = x, 1 = y, 2 = z) span the quads of each face direction.
+    struct FaceAxes { i32 normal, u, v; };
+    lt_local_persist const FaceAxes FACE_AXES[BlockFace_Count] = {
+        {0, 2, 1}, // Left
+        {0, 2, 1}, // Right
+        {1, 0, 2}, // Top
+        {1, 0, 2}, // Bottom
+        {2, 0, 1}, // Front
+        {2, 0, 1}, // Back
+    };
+
+    // Texture layer + 1 of the visible face of each block in the current slice, 0 if there is no face.
+    u16 mask[N][N];
+
+    for (i32 face_index = 0; face_index < BlockFace_Count; face_index++)
+    {
+        const BlockFace face = static_cast<BlockFace>(face_index);
+        const FaceAxes axes = FACE_AXES[face];
+
+        for (i32 slice = 0; slice < N; slice++)
+        {
+            for (i32 v = 0; v < N; v++)
+                for (i32 u = 0; u < N; u++)
+                {
+                    i32 b[3];
+                    b[axes.normal] = slice;
+                    b[axes.u] = u;
+                    b[axes.v] = v;
+
+                    mask[v][u] = 0;
+
+                    // Indexes of the block in the padded chunk.
+                    const i32 px = b[0] + 1;
+                    const i32 py = b[1] + 1;
+                    const i32 pz = b[2] + 1;
+
+                    if (!padded.is_solid(px, py, pz) || !is_face_visible(padded, px, py, pz, face))
+                        continue;
+
+                    const i32 aby = padded.base_aby + b[1];
+                    const bool should_render_top_face =
+                        (face == BlockFace_Top) || is_face_visible(padded, px, py, pz, BlockFace_Top);
+
+                    mask[v][u] = get_face_layer(aby, face, should_render_top_face) + 1;
+                }
+
+            for (i32 v = 0; v < N; v++)
+                for (i32 u = 0; u < N;)
+                {
+                    const u16 layer_plus_one = mask[v][u];
+                    if (layer_plus_one == 0)
+                    {
+                        u++;
+                        continue;
+                    }
+
+                    // Grow the quad along u.
+                    i32 w = 1;
+                    while (u + w < N && mask[v][u+w] == layer_plus_one)
+                        w++;
+
+                    // Grow the quad along v while every face of the next row matches.
+                    i32 h = 1;
+                    for (; v + h < N; h++)
+                    {
+                        bool row_matches = true;
+                        for (i32 k = 0; k < w; k++)
+                            if (mask[v+h][u+k] != layer_plus_one)
+                            {
+                                row_matches = false;
+                                break;
+                            }
+                        if (!row_matches)
+                            break;
+                    }
+
+                    for (i32 j = 0; j < h; j++)
+                        for (i32 k = 0; k < w; k++)
+                            mask[v+j][u+k] = 0;
+
+                    i32 b[3];
+                    b[axes.normal] = slice;
+                    b[axes.u] = u;
+                    b[axes.v] = v;
+
+                    i32 size[3];
+                    size[axes.normal] = 1;
+                    size[axes.u] = w;
+                    size[axes.v] = h;
+
+                    push_face_quad(vertices, b[0], b[1], b[2], size[0], size[1], size[2],
+                                   face, layer_plus_one - 1);
+                    u += w;
+                }
+        }
+    }
+}
+
+
+void
+mesh_chunk_binary(const PaddedChunk &padded, ChunkVertexBuffer &vertices)
+{
+    // NOTE: Visible faces are found a row of 16 blocks at a time: a row of faces facing a
+    // direction is the row of solid blocks minus the row of blocks next to it in that direction.
+    // The faces of each slice are then merged with the same rules as the greedy mesher, but
+    // working on the bits of each row instead of on one face at a time.
+    constexpr i32 N = Landscape::Chunk::NUM_BLOCKS_PER_AXIS;
+
+    // Which block axes (0 = x, 1 = y, 2 = z) span the quads of each face direction,
+    // u also being the axis along the bits of the rows.
+    struct FaceAxes { i32 normal, u, v; };
+    lt_local_persist const FaceAxes FACE_AXES[BlockFace_Count] = {
+        {0, 2, 1}, // Left
+        {0, 2, 1}, // Right
+        {1, 0, 2}, // Top
+        {1, 0, 2}, // Bottom
+        {2, 0, 1}, // Front
+        {2, 0, 1}, // Back
+    };
+
+    // Row of solid blocks along u for the given padded coordinates.
+    auto get_row = [&padded](i32 u_axis, i32 px, i32 py, i32 pz) -> u16 {
+        return (u_axis == 0) ? padded.occupancy_x[py][pz] : padded.occupancy_z[px][py];
+    };
+
+    // Rows of visible faces in the current slice. Side faces are split in two planes depending
+    // on the top face of the block being visible or not, since they use different textures.
+    u16 planes[2][N];
+
+    for (i32 face_index = 0; face_index < BlockFace_Count; face_index++)
+    {
+        const BlockFace face = static_cast<BlockFace>(face_index);
+        const FaceAxes axes = FACE_AXES[face];
+        const i32 *offset = FACE_NEIGHBOR_OFFSETS[face];
+        const bool is_side_face = (axes.normal != 1);
+
+        for (i32 slice = 0; slice < N; slice++)
+        {
+            for (i32 v = 0; v < N; v++)
+            {
+                i32 p[3];
+                p[axes.normal] = slice + 1;
+                p[axes.u] = 1;
+                p[axes.v] = v + 1;
+
+                const u16 solid = get_row(axes.u, p[0], p[1], p[2]);
+                const u16 neighbors = get_row(axes.u, p[0] + offset[0], p[1] + offset[1], p[2] + offset[2]);
+                const u16 faces = solid & ~neighbors;
+
+                if (is_side_face)
+                {
+                    const u16 top_faces = solid & ~get_row(axes.u, p[0], p[1] + 1, p[2]);
+                    planes[0][v] = faces & ~top_faces;
+                    planes[1][v] = faces & top_faces;
+                }
+                else
+                {
+                    planes[0][v] = faces;
+                    planes[1][v] = 0;
+                }
+            }
+
+            for (i32 plane = 0; plane < 2; plane++)
+            {
+                u16 *rows = planes[plane];
+                const bool should_render_top_face = (plane == 1);
+
+                for (i32 v = 0; v < N; v++)
+                {
+                    // Side faces are stacked along y, where the texture can change from one row to
+                    // the next, so rows can only be merged when they use the same texture.
+                    const i32 aby = padded.base_aby + (is_side_face ? v : slice);
+                    const u16 layer = get_face_layer(aby, face, should_render_top_face);
+
+                    while (rows[v] != 0)
+                    {
+                        // Grow the quad along u from the first face of the row.
+                        const i32 u = __builtin_ctz(rows[v]);
+                        const u32 shifted = static_cast<u32>(rows[v]) >> u;
+                        const i32 w = __builtin_ctz(~shifted);
+                        const u16 quad_row = static_cast<u16>(((1u << w) - 1) << u);
+
+                        // Grow the quad along v while the next row contains all of its faces.
+                        i32 h = 1;
+                        while (v + h < N && (rows[v+h] & quad_row) == quad_row)
+                        {
+                            const i32 next_aby = padded.base_aby + (is_side_face ? v + h : slice);
+                            if (get_face_layer(next_aby, face, should_render_top_face) != layer)
+                                break;
+                            rows[v+h] &= ~quad_row;
+                            h++;
+                        }
+                        rows[v] &= ~quad_row;
+
+                        i32 b[3];
+                        b[axes.normal] = slice;
+                        b[axes.u] = u;
+                        b[axes.v] = v;
+
+                        i32 size[3];
+                        size[axes.normal] = 1;
+                        size[axes.u] = w;
+                        size[axes.v] = h;
+
+                        push_face_quad(vertices, b[0], b[1], b[2], size[0], size[1], size[2], face, layer);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------------------------
+// EditableChunkMesh
+// ----------------------------------------------------------------------------------------------
+
+void
+EditableChunkMesh::build(const PaddedChunk &padded)
+{
+    std::memset(face_quads, 0xFF, sizeof(face_quads));
+    quad_faces.clear();
+    vertices.clear();
+
+    for (i32 bx = 0; bx < NUM_BLOCKS_PER_AXIS; bx++)
+        for (i32 by = 0; by < NUM_BLOCKS_PER_AXIS; by++)
+            for (i32 bz = 0; bz < NUM_BLOCKS_PER_AXIS; bz++)
+                update_block(padded, bx, by, bz);
+
+    // NOTE: The whole mesh is uploaded after being built.
+    dirty_quads.clear();
+}
+
+void
+EditableChunkMesh::update_block(const PaddedChunk &padded, i32 bx, i32 by, i32 bz)
+{
+    LT_Assert(bx >= 0 && bx < NUM_BLOCKS_PER_AXIS);
+    LT_Assert(by >= 0 && by < NUM_BLOCKS_PER_AXIS);
+    LT_Assert(bz >= 0 && bz < NUM_BLOCKS_PER_AXIS);
+
+    // Indexes of the block in the padded chunk.
+    const i32 px = bx + 1;
+    const i32 py = by + 1;
+    const i32 pz = bz + 1;
+
+    const bool is_solid = padded.is_solid(px, py, pz);
+    const i32 aby = padded.base_aby + by;
+    const bool should_render_top_face = is_solid && is_face_visible(padded, px, py, pz, BlockFace_Top);
+
+    for (i32 face_index = 0; face_index < BlockFace_Count; face_index++)
+    {
+        const BlockFace face = static_cast<BlockFace>(face_index);
+        const bool should_render_face = is_solid && is_face_visible(padded, px, py, pz, face);
+        u16 &quad = face_quads[bx][by][bz][face];
+
+        if (should_render_face)
+        {
+            Vertex_Chunk new_quad[4];
+            make_face_quad(new_quad, bx, by, bz, 1, 1, 1, face,
+                           get_face_layer(aby, face, should_render_top_face));
+
+            if (quad == NO_QUAD)
+            {
+                quad = num_quads();
+                quad_faces.push_back((((bx * NUM_BLOCKS_PER_AXIS) + by) * NUM_BLOCKS_PER_AXIS + bz) * BlockFace_Count + face);
+                vertices.insert(vertices.end(), new_quad, new_quad + 4);
+                dirty_quads.push_back(quad);
+            }
+            else if (vertices[quad*4].layer != new_quad[0].layer)
+            {
+                // The texture of the side faces changes when the top face of the block is covered.
+                std::copy(new_quad, new_quad + 4, &vertices[quad*4]);
+                dirty_quads.push_back(quad);
+            }
+        }
+        else if (quad != NO_QUAD)
+        {
+            // Move the last quad to the place of the removed one, so the mesh stays contiguous.
+            const u16 last_quad = num_quads() - 1;
+            if (quad != last_quad)
+            {
+                const u16 moved_face = quad_faces[last_quad];
+                std::copy(&vertices[last_quad*4], &vertices[last_quad*4] + 4, &vertices[quad*4]);
+                quad_faces[quad] = moved_face;
+                (&face_quads[0][0][0][0])[moved_face] = quad;
+                dirty_quads.push_back(quad);
+            }
+
+            quad_faces.pop_back();
+            vertices.resize(vertices.size() - 4);
+            quad = NO_QUAD;
+        }
+    }
+}
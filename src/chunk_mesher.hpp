@@ -0,0 +1,73 @@
+#ifndef __CHUNK_MESHER_HPP__
+#define __CHUNK_MESHER_HPP__
+
+#include <vector>
+#include "lt_core.hpp"
+#include "landscape.hpp"
+#include "vertex.hpp"
+
+//
+// Copy of the blocks of a chunk surrounded by a one block shell taken from its six neighbors.
+// It is gathered once per meshing job while holding the chunks lock, after which the meshing
+// kernels can run without touching the landscape at all.
+//
+struct PaddedChunk
+{
+    constexpr static i32 NUM_BLOCKS_PER_AXIS = Landscape::Chunk::NUM_BLOCKS_PER_AXIS + 2;
+
+    // Indexed as [x][y][z], where block (0, 0, 0) of the chunk is stored at (1, 1, 1).
+    // Blocks outside of the landscape are stored as air, so their faces are rendered.
+    u8  blocks[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS];
+    // Occupancy masks of the padded chunk, see Landscape::Chunk. Rows only span the blocks
+    // of the chunk itself, since the meshers never look at neighbors along a row.
+    u16 occupancy_x[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]; // [py][pz], bit x
+    u16 occupancy_z[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]; // [px][py], bit z
+    // Absolute y index of the first block of the chunk, used for choosing the textures.
+    i32 base_aby;
+
+    inline bool is_solid(i32 px, i32 py, i32 pz) const
+    {
+        return blocks[px][py][pz] != BlockType_Air;
+    }
+};
+
+//
+// Chunk mesh with one quad per visible block face, where every face knows where its quad is stored.
+// It is used for chunks that are being edited, since changing a block only has to patch the quads
+// of the faces around it instead of meshing the whole chunk again. Unlike the meshes built by
+// the meshers, its quads are not sorted by face direction.
+//
+struct EditableChunkMesh
+{
+    constexpr static i32 NUM_BLOCKS_PER_AXIS = Landscape::Chunk::NUM_BLOCKS_PER_AXIS;
+    constexpr static u16 NO_QUAD = 0xFFFF;
+
+    void build(const PaddedChunk &padded);
+    // Recomputes the six faces of the block, the quads that changed are appended to dirty_quads.
+    void update_block(const PaddedChunk &padded, i32 bx, i32 by, i32 bz);
+
+    inline i32 num_quads() const { return quad_faces.size(); }
+
+    // Quad of each face of every block, or NO_QUAD if the face is not visible.
+    u16 face_quads[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][BlockFace_Count];
+    // Face that owns each quad, as an index into face_quads.
+    std::vector<u16> quad_faces;
+    ChunkVertexBuffer vertices;
+    // Quads whose vertices changed since the last upload. Quads that were removed from the end
+    // of the mesh may be listed as well, and should be ignored.
+    std::vector<u16> dirty_quads;
+};
+
+// The meshers emit the quads sorted by face direction, in the order of BlockFace.
+void mesh_chunk_naive(const PaddedChunk &padded, ChunkVertexBuffer &vertices);
+void mesh_chunk_greedy(const PaddedChunk &padded, ChunkVertexBuffer &vertices);
+void mesh_chunk_binary(const PaddedChunk &padded, ChunkVertexBuffer &vertices);
+// Replaces the blocks of the chunk by cells of (2^lod)^3 blocks, which are solid depending on the
+// downsampling, see Landscape::LodDownsampling. The border taken from the neighbors is kept as is,
+// so faces on the border are only culled against real blocks and no holes appear next to chunks
+// with a different lod.
+void downsample_padded_chunk(PaddedChunk &padded, i32 lod, Landscape::LodDownsampling downsampling);
+// Counts the quads of each face direction of a mesh sorted by face direction.
+void count_face_quads(const ChunkVertexBuffer &vertices, u32 face_num_quads[BlockFace_Count]);
+
+#endif // __CHUNK_MESHER_HPP__
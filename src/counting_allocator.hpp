@@ -0,0 +1,50 @@
+#ifndef __COUNTING_ALLOCATOR_HPP__
+#define __COUNTING_ALLOCATOR_HPP__
+
+#include <atomic>
+#include <memory>
+#include "lt_core.hpp"
+
+// Allocations made by the containers of one kind of buffer, since the program started.
+struct AllocationCounter
+{
+    std::atomic<u64> num_allocations{0};
+    std::atomic<u64> num_bytes{0};
+};
+
+//
+// Standard allocator that counts its allocations. It is meant for buffers that are supposed to be
+// reused, so the statistics tell how often they really went to the heap instead of guessing it.
+//
+template<typename T, AllocationCounter &COUNTER>
+struct CountingAllocator
+{
+    using value_type = T;
+
+    // NOTE: The counter is not a type, so the allocator cannot be rebound automatically.
+    template<typename U>
+    struct rebind { using other = CountingAllocator<U, COUNTER>; };
+
+    CountingAllocator() = default;
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U, COUNTER>&) {}
+
+    T *allocate(usize count)
+    {
+        COUNTER.num_allocations.fetch_add(1, std::memory_order_relaxed);
+        COUNTER.num_bytes.fetch_add(count * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T *pointer, usize count)
+    {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+};
+
+template<typename T, typename U, AllocationCounter &COUNTER>
+inline bool operator==(const CountingAllocator<T, COUNTER>&, const CountingAllocator<U, COUNTER>&) { return true; }
+template<typename T, typename U, AllocationCounter &COUNTER>
+inline bool operator!=(const CountingAllocator<T, COUNTER>&, const CountingAllocator<U, COUNTER>&) { return false; }
+
+#endif // __COUNTING_ALLOCATOR_HPP__
@@ -51,6 +51,10 @@ struct IOTask
 protected:
     std::atomic<IOTaskStatus> m_status;
     virtual void run() = 0;
+
+private:
+    // Manager running the task, set when the task is added to its queue.
+    IOTaskManager *m_manager = nullptr;
 };
 
 struct LoadImagesTask : IOTask
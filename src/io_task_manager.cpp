@@ -1,61 +1,42 @@
 #include "io_task_manager.hpp"
+#include "job_system.hpp"
 #include "lt_utils.hpp"
-#include <chrono>
+#include <thread>
 
 lt_global_variable lt::Logger logger("io_task_manager");
 
-IOTaskManager::IOTaskManager()
-    : m_thread_running(false)
-    , m_wake_up_thread(false)
-    , m_task_thread(&IOTaskManager::run, this)
+IOTaskManager::IOTaskManager(JobSystem *job_system)
+    : m_job_system(job_system)
+    , m_num_pending_tasks(0)
 {
+    LT_Assert(job_system);
 }
 
 IOTaskManager::~IOTaskManager()
 {
-    stop();
-    m_task_thread.join();
+    // NOTE: Queued tasks still point to the manager, so it waits for them to finish.
+    if (m_num_pending_tasks > 0)
+        logger.log("Waiting for ", m_num_pending_tasks, " tasks to finish.");
+    while (m_num_pending_tasks > 0)
+        std::this_thread::yield();
 }
 
 void
-IOTaskManager::run()
+IOTaskManager::run_task(void *data)
 {
-    logger.log("Started task manager in thread ", std::this_thread::get_id());
-    m_thread_running = true;
-    while (m_thread_running)
-    {
-        std::unique_lock<std::mutex> locker(m_task_queue_mutex);
-
-        m_task_added.wait(locker, [&]{ return m_wake_up_thread; });
-
-        while (!m_task_queue.empty())
-        {
-            m_task_queue.front()->run();
-            m_task_queue.pop();
-            logger.log("Running task.");
-        }
-
-        m_wake_up_thread = false;
-    }
+    IOTask *task = static_cast<IOTask*>(data);
+    IOTaskManager *manager = task->m_manager;
+    task->run();
+    manager->m_num_pending_tasks--;
 }
 
 void
 IOTaskManager::add_to_queue(IOTask *task)
 {
-    std::unique_lock<std::mutex> locker(m_task_queue_mutex);
-    m_task_queue.push(task);
-    m_task_added.notify_one();
-    m_wake_up_thread = true;
-}
-
-void
-IOTaskManager::stop()
-{
-    logger.log("Stopping task manager thread.");
-    m_thread_running = false;
-    // NOTE: A "work" signal is sent to the thread, however there is no work to do.
-    // This is only done to wake up the thread so it can check that the variable 'm_thread_running'
-    // is false so it can exit.
-    m_wake_up_thread = true;
-    m_task_added.notify_one();
+    LT_Assert(task);
+    task->m_manager = this;
+    m_num_pending_tasks++;
+    // PERFORMANCE: Tasks wait on the disk most of the time, so the work the player is waiting
+    // for goes first.
+    m_job_system->submit(Job{&IOTaskManager::run_task, task}, JobPriority_Low);
 }
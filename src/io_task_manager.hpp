@@ -1,36 +1,29 @@
 #ifndef __IO_TASK_MANAGER_HPP__
 #define __IO_TASK_MANAGER_HPP__
 
-#include <string>
-#include <thread>
-#include <mutex>
-#include <memory>
 #include <atomic>
-#include <queue>
-#include <unordered_map>
-#include <condition_variable>
 #include "lt_core.hpp"
 #include "io_task.hpp"
 
+struct JobSystem;
+
+// Runs io tasks as low priority jobs of the job system, so they use the same threads as the
+// rest of the background work.
 struct IOTaskManager
 {
     void add_to_queue(IOTask *task);
 
-    IOTaskManager();
+    explicit IOTaskManager(JobSystem *job_system);
     ~IOTaskManager();
 
-private:
-    std::atomic<bool> m_thread_running;
-    std::condition_variable m_task_added;
-    bool m_wake_up_thread;
-
-    std::queue<IOTask*> m_task_queue;
-    std::mutex m_task_queue_mutex;
+    inline JobSystem *job_system() const { return m_job_system; }
 
-    std::thread m_task_thread;
+private:
+    JobSystem       *m_job_system;
+    // Tasks that were added and did not finish running yet.
+    std::atomic<i32> m_num_pending_tasks;
 
-    void run();
-    void stop();
+    static void run_task(void *data);
 };
 
 #endif // __IO_TASK_MANAGER_HPP__
@@ -0,0 +1,132 @@
+#include "job_system.hpp"
+#include "lt_utils.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+lt_global_variable lt::Logger logger("job_system");
+
+// Index of the worker running on the current thread, or -1 outside of the workers.
+lt_global_variable thread_local i32 t_worker_index = -1;
+
+JobSystem::JobSystem(i32 num_threads, bool pin_threads)
+    : m_next_worker(0)
+    , m_running(true)
+{
+    const i32 num_cpu_cores = (i32)std::thread::hardware_concurrency();
+    if (num_threads <= 0)
+    {
+        // NOTE: One core is left to the main thread, but on a single core computer the work
+        // still needs a thread to run on.
+        if (num_cpu_cores == 0)
+            logger.error("Could not find the number of cores in this computer, using one thread.");
+        num_threads = std::max(num_cpu_cores - 1, 1);
+    }
+
+    for (i32 i = 0; i < num_threads; i++)
+        m_workers.push_back(std::make_unique<Worker>());
+
+    for (i32 i = 0; i < num_threads; i++)
+    {
+        m_threads.push_back(std::thread(&JobSystem::run_worker, this, i));
+
+        if (pin_threads && num_cpu_cores > 1)
+        {
+#ifdef __linux__
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(1 + i % (num_cpu_cores - 1), &cpu_set);
+            if (pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cpu_set), &cpu_set) != 0)
+                logger.error("Could not pin worker ", i, " to a core.");
+#else
+            logger.error("Pinning threads is not supported on this platform.");
+#endif
+        }
+    }
+
+    logger.log("Started ", num_threads, " worker threads", pin_threads ? " pinned to cores." : ".");
+}
+
+JobSystem::~JobSystem()
+{
+    logger.log("Stopping worker threads...");
+    m_running = false;
+    // NOTE: The workers are woken up without work, so they see that they should stop.
+    m_jobs_available.notify_all(num_threads());
+    for (auto &thread : m_threads) thread.join();
+}
+
+void
+JobSystem::submit(Job job, JobPriority priority)
+{
+    LT_Assert(job.function);
+    LT_Assert(priority >= 0 && priority < JobPriority_Count);
+
+    const i32 worker_index = (t_worker_index >= 0)
+        ? t_worker_index
+        : (i32)(m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size());
+
+    Worker &worker = *m_workers[worker_index];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.jobs[priority].push_back(job);
+    }
+
+    m_jobs_available.notify();
+}
+
+bool
+JobSystem::take_job(i32 worker_index, Job &job)
+{
+    const i32 num_workers = (i32)m_workers.size();
+
+    for (i32 priority = 0; priority < JobPriority_Count; priority++)
+    {
+        // NOTE: Jobs are always taken oldest first, also from the own queue of the worker. Landscape
+        // jobs submit more jobs while they run, and taking the newest job first would leave an io
+        // job queued before them waiting for as long as the landscape keeps the workers busy.
+        for (i32 i = 0; i < num_workers; i++)
+        {
+            Worker &worker = *m_workers[(worker_index + i) % num_workers];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            auto &jobs = worker.jobs[priority];
+            if (!jobs.empty())
+            {
+                job = jobs.front();
+                jobs.pop_front();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void
+JobSystem::run_worker(i32 worker_index)
+{
+    t_worker_index = worker_index;
+    logger.log("Worker ", worker_index, " started in thread ", std::this_thread::get_id());
+
+    for (;;)
+    {
+        m_jobs_available.wait();
+        if (!m_running)
+            break;
+
+        // NOTE: Every wake up matches a queued job, but another worker can take it first. The job
+        // that woke up that worker is then still queued, so the queues are looked at again.
+        Job job;
+        while (!take_job(worker_index, job))
+        {
+            if (!m_running)
+                return;
+            std::this_thread::yield();
+        }
+
+        job.function(job.data);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef __JOB_SYSTEM_HPP__
+#define __JOB_SYSTEM_HPP__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include "lt_core.hpp"
+#include "semaphore.hpp"
+
+enum JobPriority
+{
+    // Work the player is waiting for, e.g. generating the chunks around the camera.
+    JobPriority_High = 0,
+    JobPriority_Low = 1,
+    JobPriority_Count = 2,
+};
+
+// A job is a plain function pointer and its argument, so submitting a job does not allocate.
+// The data has to stay alive until the job ran.
+struct Job
+{
+    void (*function)(void *data);
+    void *data;
+};
+
+//
+// Worker threads shared by every system that has work to do in the background, like the landscape
+// and the io tasks. Each worker has its own queues, one per priority. A worker runs the jobs of
+// its queues first, and when they are empty it steals jobs from the other workers, so no worker
+// is idle while another one is backlogged. High priority jobs of any worker are run before low
+// priority ones.
+//
+// Jobs must not wait for other jobs or for the main thread. A job that cannot go on, e.g. because
+// a queue is full, gives its work back to its owner and returns, since a waiting job holds a
+// worker that the job it waits for may need.
+//
+struct JobSystem
+{
+    // With zero threads, one thread is created for each core but the one of the main thread,
+    // and at least one. Pinned threads are kept on a single core each, skipping the first core.
+    explicit JobSystem(i32 num_threads = 0, bool pin_threads = false);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem &operator=(const JobSystem&) = delete;
+
+    // Can be called from any thread. Jobs submitted from a worker go to the queue of the worker.
+    void submit(Job job, JobPriority priority);
+
+    inline i32 num_threads() const { return (i32)m_threads.size(); }
+
+private:
+    struct Worker
+    {
+        std::mutex      mutex;
+        std::deque<Job> jobs[JobPriority_Count];
+    };
+
+    void run_worker(i32 worker_index);
+    // Takes the oldest job of the worker, or steals the oldest job of another worker.
+    bool take_job(i32 worker_index, Job &job);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread>             m_threads;
+    // Worker that receives the next job submitted from outside of the workers.
+    std::atomic<u32>                     m_next_worker;
+    std::atomic<bool>                    m_running;
+    // Counts the jobs that no worker took yet.
+    Semaphore                            m_jobs_available;
+};
+
+#endif // __JOB_SYSTEM_HPP__
@@ -1,6 +1,7 @@
 #include "landscape.hpp"
 #include "open-simplex-noise.h"
 #include "lt_utils.hpp"
+#include "glad/glad.h"
 #include "gl_resources.hpp"
 #include "texture.hpp"
 #include "resource_manager.hpp"
@@ -8,63 +9,201 @@
 #include "camera.hpp"
 #include "world.hpp"
 #include "input.hpp"
-
-using std::placeholders::_1;
+#include "chunk_mesher.hpp"
+#include "io_task_manager.hpp"
+#include "job_system.hpp"
+#include "world_coordinates.hpp"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
 
 lt_global_variable lt::Logger logger("landscape");
 
-lt_internal inline Vec3f
-get_world_coords(const Landscape::Chunk &chunk, i32 block_xi, i32 block_yi, i32 block_zi)
+// Shared locks of a chunk and its neighbors. The locks are taken in address order, so two threads
+// reading overlapping chunks cannot deadlock while a third one waits to write one of them.
+struct ChunkReadLocks
 {
-    Vec3f coords;
-    coords.x = chunk.origin.x + (block_xi * Landscape::Chunk::BLOCK_SIZE);
-    coords.y = chunk.origin.y + (block_yi * Landscape::Chunk::BLOCK_SIZE);
-    coords.z = chunk.origin.z + (block_zi * Landscape::Chunk::BLOCK_SIZE);
-    return coords;
-}
+    constexpr static i32 MAX_CHUNKS = 7;
+
+    ChunkReadLocks() : m_num_chunks(0), m_is_locked(false) {}
+    ~ChunkReadLocks()
+    {
+        if (m_is_locked)
+            for (i32 i = 0; i < m_num_chunks; i++)
+                m_chunks[i]->mutex.unlock_shared();
+    }
+
+    ChunkReadLocks(const ChunkReadLocks&) = delete;
+    ChunkReadLocks &operator=(const ChunkReadLocks&) = delete;
+
+    // Null chunks are ignored.
+    void add(const Landscape::Chunk *chunk)
+    {
+        LT_Assert(!m_is_locked);
+        LT_Assert(m_num_chunks < MAX_CHUNKS);
+        if (chunk)
+            m_chunks[m_num_chunks++] = chunk;
+    }
+
+    void lock()
+    {
+        LT_Assert(!m_is_locked);
+        std::sort(m_chunks, m_chunks + m_num_chunks);
+        for (i32 i = 0; i < m_num_chunks; i++)
+            m_chunks[i]->mutex.lock_shared();
+        m_is_locked = true;
+    }
 
-Landscape::Landscape(Memory &memory, i32 seed, f64 amplitude,
+private:
+    const Landscape::Chunk *m_chunks[MAX_CHUNKS];
+    i32                     m_num_chunks;
+    bool                    m_is_locked;
+};
+
+Landscape::Landscape(Memory &memory, IOTaskManager *io_task_manager, i32 seed, f64 amplitude,
                      f64 frequency, i32 num_octaves, f64 lacunarity, f64 gain)
-    : origin(Vec3f(0))
+    : m_center_column_x(0)
+    , m_center_column_z(0)
     , m_seed(seed)
     , m_amplitude(amplitude)
     , m_frequency(frequency)
     , m_num_octaves(num_octaves)
     , m_lacunarity(lacunarity)
     , m_gain(gain)
-    , m_threads_should_run(false)
+    , m_job_system(io_task_manager->job_system())
+    , m_jobs_should_run(false)
+    , m_num_pending_jobs(0)
+    , m_noise_precision(NoisePrecision_F64)
+    , m_noise_sampling(NoiseSamplingSettings{NoiseSampling_Full, 1})
+    , m_terrain_mode(TerrainMode_Heightmap)
+    , m_meshing_mode(MeshingMode_Binary)
+    , m_lod_downsampling(LodDownsampling_AnySolid)
+    , m_remesh_cursor(NUM_REMESH_COLUMNS)
+    , m_remesh_center_x(0)
+    , m_remesh_center_z(0)
+    , m_num_edits(0)
+    , m_edit_padded(std::make_unique<PaddedChunk>())
+    , m_mesh_cache(memory.mesh_cache_size)
+    , m_num_chunks_meshed(0)
     , m_chunks_allocator(memory.chunks_memory, memory.chunks_memory_size,
                          sizeof(Chunk), alignof(Chunk))
+    , m_view_distance(DEFAULT_VIEW_DISTANCE)
+    , m_target_view_distance(DEFAULT_VIEW_DISTANCE)
+    , m_auto_view_distance(false)
+    , m_average_frame_time_ms(FRAME_TIME_BUDGET_MS)
+    , m_frames_since_view_change(0)
+    , m_region_store("../saves/world_" + std::to_string(seed), MAX_COLUMNS_PER_AXIS)
+    , m_io_task_manager(io_task_manager)
+    , m_flush_regions_task(std::make_unique<FlushRegionsTask>(&m_region_store))
+    , m_request_pool(&m_vertex_buffer_pool)
 {
-    const u32 num_cpu_cores = std::thread::hardware_concurrency();
-    if (num_cpu_cores == 0)
-        LT_Panic("Could not find the number of cores in this computer.");
-    else if (num_cpu_cores == 1)
-        LT_Panic("This computer only has one core.");
-    else
-    {
-        // NOTE: One thread should be reserved for the main thread.
-        m_threads = std::vector<std::thread>(num_cpu_cores-1);
-    }
+    static_assert(NUM_CHUNKS_Y <= RegionStore::MAX_CHUNKS_Y, "Columns of chunks do not fit in a region.");
 
     if (open_simplex_noise(seed, &m_simplex_ctx))
         LT_Panic("Failed to initialize context for noise generation.");
 
+    // NOTE: At the default view distance the camera sees about 144 blocks away.
+    m_lod_distances[0] = 64.0f;
+    m_lod_distances[1] = 112.0f;
+
+    for (i32 x = 0; x < MAX_COLUMNS_PER_AXIS; x++)
+        for (i32 z = 0; z < MAX_COLUMNS_PER_AXIS; z++)
+            m_column_heightmaps[x][z].is_valid = false;
+
+    for (auto &slot : m_evicted_chunks)
+    {
+        slot.chunk = nullptr;
+        slot.eviction = 0;
+    }
+    m_num_evictions = 0;
+
+    // NOTE: Every loaded chunk fits in the lists, so deferring a request never allocates.
+    m_deferred_chunks.reserve(MAX_CHUNKS);
+    m_retried_chunks.reserve(MAX_CHUNKS);
+
+    for (auto &slot : m_editable_meshes)
+    {
+        slot.chunk = nullptr;
+        slot.last_edit = 0;
+        slot.capacity_quads = 0;
+    }
+
     initialize_chunks();
-    initialize_threads();
+    m_jobs_should_run = true;
 }
 
 Landscape::~Landscape()
 {
-    stop_threads();
+    stop_jobs();
+
+    // NOTE: Edits are written before leaving, waiting for the flush task in case it is
+    // still writing chunks that were unloaded.
+    for (i32 i = 0; i < m_chunk_map.num_chunks(); i++)
+        save_chunk_if_dirty(m_chunk_map.chunk_at(i));
+
+    while (m_flush_regions_task->status() == TaskStatus_Processing)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    m_region_store.flush();
+
+    // NOTE: The map is not changed while going over it, the chunks are destroyed without being removed.
+    for (i32 i = 0; i < m_chunk_map.num_chunks(); i++)
+        destroy_chunk(m_chunk_map.chunk_at(i));
+    for (auto &slot : m_evicted_chunks)
+        if (slot.chunk) destroy_chunk(slot.chunk);
+
     open_simplex_noise_free(m_simplex_ctx);
 }
 
-Vec3f
-Landscape::get_chunk_origin(i32 cx, i32 cy, i32 cz)
+i32
+Landscape::get_chunk_lod(const Chunk *chunk, Vec3f eye) const
+{
+    // NOTE: Chunks in the same column use the same level of detail, so the height is ignored.
+    const f32 dx = chunk->origin.x + 0.5f*Chunk::SIZE - eye.x;
+    const f32 dz = chunk->origin.z + 0.5f*Chunk::SIZE - eye.z;
+    const f32 distance = std::sqrt(dx*dx + dz*dz);
+
+    // Chunks close to a ring keep their level of detail, so that they are not remeshed
+    // over and over while the camera moves around the ring.
+    const f32 HYSTERESIS = 0.25f*Chunk::SIZE;
+
+    i32 nearest_lod = 0;
+    i32 farthest_lod = 0;
+    for (i32 i = 0; i < NUM_LODS-1; i++)
+    {
+        if (distance > m_lod_distances[i] - HYSTERESIS) nearest_lod = i+1;
+        if (distance > m_lod_distances[i] + HYSTERESIS) farthest_lod = i+1;
+    }
+
+    if (chunk->lod >= farthest_lod && chunk->lod <= nearest_lod)
+        return chunk->lod;
+
+    i32 lod = 0;
+    for (i32 i = 0; i < NUM_LODS-1; i++)
+        if (distance > m_lod_distances[i]) lod = i+1;
+    return lod;
+}
+
+void
+Landscape::move_center(i32 step_x, i32 step_z, Vec3f eye)
+{
+    LT_Assert(std::abs(step_x) + std::abs(step_z) == 1);
+
+    chunks_mutex.lock_high_priority(); // LOCK
+
+    // NOTE: Chunks are found by their coordinates, so the loaded chunks stay where they are and only
+    // the columns at the edges of the view are loaded or unloaded.
+    m_center_column_x += step_x;
+    m_center_column_z += step_z;
+    refresh_chunks_in_view(eye);
+
+    chunks_mutex.unlock_high_priority(); // UNLOCK
+}
+
+void
+Landscape::set_lod_distance(i32 lod, f32 distance)
 {
-    const Vec3f new_origin = origin + Vec3f(cx*Chunk::SIZE, cy*Chunk::SIZE, cz*Chunk::SIZE);
-    return new_origin;
+    LT_Assert(lod > 0 && lod < NUM_LODS);
+    m_lod_distances[lod-1] = distance;
 }
 
 void
@@ -79,248 +218,397 @@ Landscape::update(const Camera &camera, const Input &input)
 
         for (auto &queue : m_chunks_processed_queues)
         {
-            std::shared_ptr<QueueRequest> request = nullptr;
-            while (chunks_loaded++ < MAX_CHUNKS_TO_LOAD && (request = queue.take_next_request()))
+            RequestHandle handle;
+            while (chunks_loaded++ < MAX_CHUNKS_TO_LOAD && (handle = queue.take_next_request()).is_valid())
             {
+                QueueRequest *request = &m_request_pool[handle];
                 LT_Assert(request->processed);
 
-                if (request->chunk)
+                // NOTE: Only the latest request of a chunk is uploaded. Older requests may have
+                // been meshed before a block was edited, and the edit would be lost. Chunks leave
+                // the landscape from this thread and cancel their request first, so the chunk of
+                // a current request is still alive.
+                // NOTE: The vao entry of a chunk is only used by the main thread, so uploading the
+                // mesh does not need to stop the workers.
+                Chunk *chunk = request->chunk;
+                if (m_request_pool.is_current(handle))
                 {
-                    chunks_mutex.lock_high_priority(); // LOCK
+                    // The chunk mesh is about to be replaced, so any editable mesh is now stale.
+                    release_editable_mesh(chunk);
 
-                    auto &entry = vao_array.vaos[request->chunk->entry_index];
-                    entry.num_vertices_used = request->vertexes.size();
+                    const u32 num_quads = request->vertexes.size() / 4;
+                    VAOArray::Entry *entry = nullptr;
 
-                    chunks_mutex.unlock_high_priority(); // UNLOCK
+                    // NOTE: Chunks only hold a vao while they have something to render.
+                    if (num_quads > 0)
+                    {
+                        entry = &chunk->take_entry();
+                        entry->num_quads = num_quads;
+                        entry->is_sorted_by_face = true;
+                        std::copy(request->face_num_quads, request->face_num_quads + BlockFace_Count,
+                                  entry->face_num_quads);
+                    }
+                    else
+                    {
+                        chunk->release_entry();
+                    }
 
-                    if (entry.num_vertices_used > 0)
-                        pass_chunk_buffer_to_gpu(entry, request->vertexes);
+                    if (entry)
+                        pass_chunk_buffer_to_gpu(*entry, request->vertexes);
                 }
+
+                m_request_pool.give_back(handle);
             }
         }
     }
 
-    const f32 x_distance_to_center = camera.position().x - center().x;
-    const f32 z_distance_to_center = camera.position().z - center().z;
-
-    // NOTE: Ignore the y axis for the moment.
-    const f32 chosen_distance = 1*Chunk::SIZE;
+    // Requests that did not fit in the queues are queued again once the workers made room for them.
+    retry_deferred_requests();
 
-    if (x_distance_to_center > chosen_distance) // positive x
+    // The view distance changes one ring of chunks at a time, once the queues have room for the
+    // requests of the ring and of the chunks next to it.
+    if (m_view_distance != m_target_view_distance)
     {
-        chunks_mutex.lock_high_priority(); // LOCK
-        origin.x += chosen_distance;
-
-        for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
-            for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
-                for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
-                {
-                    if (cx > 0)
-                    {
-                        chunk_ptrs[cx-1][cy][cz] = std::move(chunk_ptrs[cx][cy][cz]);
-                        LT_Assert(chunk_ptrs[cx-1][cy][cz]);
-
-                        if (cx == NUM_CHUNKS_X-1)
-                        {
-                            const Vec3f chunk_origin = get_chunk_origin(cx, cy, cz);
-
-                            Chunk *chunk = memory::allocate_and_construct<Chunk>(
-                                m_chunks_allocator, chunk_origin, &vao_array
-                            );
-                            LT_Assert(chunk);
-                            chunk_ptrs[cx][cy][cz] = ChunkPtr(
-                                chunk, std::bind(&Landscape::chunk_deleter, this, _1)
-                            );
-                            LT_Assert(chunk_ptrs[cx][cy][cz]);
-
-                            do_chunk_generation_work(chunk);
-
-                            chunk->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk->request,
-                                                                      &m_chunks_to_process_semaphore);
-
-                            chunk_ptrs[cx-1][cy][cz]->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk_ptrs[cx-1][cy][cz]->request,
-                                                                      &m_chunks_to_process_semaphore);
-                        }
-                    }
-                    else
-                    {
-                        // Remove chunks that are outside of the landscape boundary.
-                        // TODO: In the future such chunks should be persisted to disk
-                        // or something similar.
-                        chunk_ptrs[cx][cy][cz]->cancel_request();
-                        chunk_ptrs[cx][cy][cz].reset();
-                    }
-                }
-        chunks_mutex.unlock_high_priority(); // UNLOCK
+        // NOTE: The ring of columns at the view distance is a circle, which has less than
+        // 8*MAX_VIEW_DISTANCE columns.
+        const i32 MAX_RING_REQUESTS = 3 * 8*MAX_VIEW_DISTANCE*NUM_CHUNKS_Y;
+        if (m_chunks_to_process_queues[QP_High].num_free_entries() >= MAX_RING_REQUESTS &&
+            m_chunks_to_process_queues[QP_Low].num_free_entries() >= MAX_RING_REQUESTS)
+        {
+            chunks_mutex.lock_high_priority(); // LOCK
+            m_view_distance += (m_target_view_distance > m_view_distance) ? 1 : -1;
+            refresh_chunks_in_view(camera.position());
+            chunks_mutex.unlock_high_priority(); // UNLOCK
+        }
     }
-    else if (x_distance_to_center < -chosen_distance) // negative x
+
+    // After the meshing mode changed, gradually remesh every chunk without overflowing the queue.
+    if (m_remesh_cursor < NUM_REMESH_COLUMNS)
     {
-        chunks_mutex.lock_high_priority(); // LOCK
-        origin.x -= chosen_distance;
+        const i32 REMESH_SIZE = 2*MAX_VIEW_DISTANCE + 1;
+        const i32 MAX_CHUNKS_TO_REMESH = REMESH_SIZE*NUM_CHUNKS_Y;
+        auto &queue = m_chunks_to_process_queues[QP_Low];
+
+        // NOTE: Only the main thread loads and unloads chunks, so it does not need the chunks mutex for
+        // finding them. queue_chunk_meshing takes the locks of the chunks it reads.
+        const i32 max_chunks_to_remesh = std::min(MAX_CHUNKS_TO_REMESH, queue.num_free_entries());
+        i32 num_chunks_remeshed = 0;
+        while (num_chunks_remeshed + NUM_CHUNKS_Y <= max_chunks_to_remesh && m_remesh_cursor < NUM_REMESH_COLUMNS)
+        {
+            const i32 column_x = m_remesh_center_x + m_remesh_cursor / REMESH_SIZE - MAX_VIEW_DISTANCE;
+            const i32 column_z = m_remesh_center_z + m_remesh_cursor % REMESH_SIZE - MAX_VIEW_DISTANCE;
+            m_remesh_cursor++;
 
-        for (i32 cx = NUM_CHUNKS_X-1; cx >= 0; cx--)
             for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
-                for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
-                {
-                    if (cx < NUM_CHUNKS_X-1)
-                    {
-                        chunk_ptrs[cx+1][cy][cz] = std::move(chunk_ptrs[cx][cy][cz]);
-                        LT_Assert(chunk_ptrs[cx+1][cy][cz]);
-
-                        if (cx == 0)
-                        {
-                            const Vec3f chunk_origin = get_chunk_origin(cx, cy, cz);
-
-                            Chunk *chunk = memory::allocate_and_construct<Chunk>(
-                                m_chunks_allocator, chunk_origin, &vao_array
-                            );
-                            chunk_ptrs[cx][cy][cz] = ChunkPtr(
-                                chunk, std::bind(&Landscape::chunk_deleter, this, _1)
-                            );
-                            LT_Assert(chunk_ptrs[cx][cy][cz]);
-
-                            do_chunk_generation_work(chunk);
-                            chunk->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk->request,
-                                                                      &m_chunks_to_process_semaphore);
-
-                            chunk_ptrs[cx+1][cy][cz]->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk_ptrs[cx+1][cy][cz]->request,
-                                                                      &m_chunks_to_process_semaphore);
-                        }
-                    }
-                    else
-                    {
-                        // Remove chunks that are outside of the landscape boundary.
-                        // TODO: In the future such chunks should be persisted to disk
-                        // or something similar.
-                        chunk_ptrs[cx][cy][cz]->cancel_request();
-                        chunk_ptrs[cx][cy][cz].reset();
-                    }
-                }
-        chunks_mutex.unlock_high_priority(); // UNLOCK
+            {
+                // NOTE: Chunks that are still being generated are meshed once their blocks are ready,
+                // and chunks out of view once they come back into view.
+                Chunk *chunk = find_chunk_in_view(column_x, cy, column_z);
+                if (!chunk || !chunk->is_generated)
+                    continue;
+
+                queue_chunk_meshing(chunk);
+                num_chunks_remeshed++;
+            }
+        }
     }
 
-    if (z_distance_to_center > chosen_distance) // positive z
+    // Change the level of detail of the chunks that moved across a distance ring. Chunks out of
+    // view get their level of detail when they come back into view.
     {
-        chunks_mutex.lock_high_priority(); // LOCK
-        origin.z += chosen_distance;
+        const i32 MAX_LOD_CHANGES = (2*MAX_VIEW_DISTANCE + 1)*NUM_CHUNKS_Y;
+        auto &queue = m_chunks_to_process_queues[QP_Low];
 
-        for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
-            for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
-                for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
-                {
-                    if (cz > 0)
-                    {
-                        chunk_ptrs[cx][cy][cz-1] = std::move(chunk_ptrs[cx][cy][cz]);
-                        LT_Assert(chunk_ptrs[cx][cy][cz-1]);
-
-                        if (cz == NUM_CHUNKS_Z-1)
-                        {
-                            const Vec3f chunk_origin = get_chunk_origin(cx, cy, cz);
-                            Chunk *chunk = memory::allocate_and_construct<Chunk>(
-                                m_chunks_allocator, chunk_origin, &vao_array
-                            );
-                            chunk_ptrs[cx][cy][cz] = ChunkPtr(
-                                chunk, std::bind(&Landscape::chunk_deleter, this, _1)
-                            );
-                            LT_Assert(chunk_ptrs[cx][cy][cz]);
-
-                            do_chunk_generation_work(chunk);
-                            chunk->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk->request,
-                                                                      &m_chunks_to_process_semaphore);
-
-                            chunk_ptrs[cx][cy][cz-1]->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk_ptrs[cx][cy][cz-1]->request,
-                                                                      &m_chunks_to_process_semaphore);
-                        }
-                    }
-                    else
-                    {
-                        // Remove chunks that are outside of the landscape boundary.
-                        // TODO: In the future such chunks should be persisted to disk
-                        // or something similar.
-                        chunk_ptrs[cx][cy][cz]->cancel_request();
-                        chunk_ptrs[cx][cy][cz].reset();
-                    }
-                }
-        chunks_mutex.unlock_high_priority(); // UNLOCK
-    }
-    else if (z_distance_to_center < -chosen_distance) // negative z
-    {
-        chunks_mutex.lock_high_priority(); // LOCK
-        origin.z -= chosen_distance;
+        const i32 max_lod_changes = std::min(MAX_LOD_CHANGES, queue.num_free_entries());
+        i32 num_lod_changes = 0;
+
+        for (i32 dx = -m_view_distance; dx <= m_view_distance && num_lod_changes < max_lod_changes; dx++)
+            for (i32 dz = -m_view_distance; dz <= m_view_distance && num_lod_changes < max_lod_changes; dz++)
+            {
+                const i32 column_x = m_center_column_x + dx;
+                const i32 column_z = m_center_column_z + dz;
+                const Chunk *bottom_chunk = find_chunk_in_view(column_x, 0, column_z);
+                if (!bottom_chunk)
+                    continue;
+
+                const i32 lod = get_chunk_lod(bottom_chunk, camera.position());
+                if (lod == bottom_chunk->lod)
+                    continue;
 
-        for (i32 cz = NUM_CHUNKS_Z-1; cz >= 0; cz--)
-            for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
                 for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
                 {
-                    if (cz < NUM_CHUNKS_Z-1)
-                    {
-                        chunk_ptrs[cx][cy][cz+1] = std::move(chunk_ptrs[cx][cy][cz]);
-                        LT_Assert(chunk_ptrs[cx][cy][cz+1]);
-
-                        if (cz == 0)
-                        {
-                            const Vec3f chunk_origin = get_chunk_origin(cx, cy, cz);
-                            Chunk *chunk = memory::allocate_and_construct<Chunk>(
-                                m_chunks_allocator, chunk_origin, &vao_array
-                            );
-                            chunk_ptrs[cx][cy][cz] = ChunkPtr(
-                                chunk, std::bind(&Landscape::chunk_deleter, this, _1)
-                            );
-                            LT_Assert(chunk_ptrs[cx][cy][cz]);
-
-                            do_chunk_generation_work(chunk);
-                            chunk->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk->request,
-                                                                      &m_chunks_to_process_semaphore);
-
-                            chunk_ptrs[cx][cy][cz+1]->create_request();
-                            m_chunks_to_process_queues[QP_Low].insert(chunk_ptrs[cx][cy][cz+1]->request,
-                                                                      &m_chunks_to_process_semaphore);
-                        }
-                    }
-                    else
-                    {
-                        // Remove chunks that are outside of the landscape boundary.
-                        // TODO: In the future such chunks should be persisted to disk
-                        // or something similar.
-                        chunk_ptrs[cx][cy][cz]->cancel_request();
-                        chunk_ptrs[cx][cy][cz].reset();
-                    }
+                    Chunk *chunk = find_chunk(column_x, cy, column_z);
+                    chunk->lod = lod;
+                    if (!chunk->is_generated)
+                        continue;
+
+                    queue_chunk_meshing(chunk);
+                    num_lod_changes++;
                 }
-        chunks_mutex.unlock_high_priority(); // UNLOCK
+            }
     }
 
+    const f32 x_distance_to_center = camera.position().x - center().x;
+    const f32 z_distance_to_center = camera.position().z - center().z;
+
+    // NOTE: Ignore the y axis for the moment.
+    const f32 chosen_distance = 1*Chunk::SIZE;
+
+    if (x_distance_to_center > chosen_distance)
+        move_center(1, 0, camera.position());
+    else if (x_distance_to_center < -chosen_distance)
+        move_center(-1, 0, camera.position());
+    else if (z_distance_to_center > chosen_distance)
+        move_center(0, 1, camera.position());
+    else if (z_distance_to_center < -chosen_distance)
+        move_center(0, -1, camera.position());
+
     if (input.mouse_state.left_button_transition == Transition_Down)
     {
         remove_block(camera.position(), camera.front());
     }
+
+    // Saved chunks are written by an io task, which is only queued again once it finished
+    // writing the chunks saved before.
+    if (m_flush_regions_task->status() == TaskStatus_Complete && m_region_store.should_flush())
+    {
+        m_flush_regions_task->set_queued();
+        m_io_task_manager->add_to_queue(m_flush_regions_task.get());
+    }
 }
 
 bool
 Landscape::block_exists(i32 abs_block_xi, i32 abs_block_yi, i32 abs_block_zi)
 {
-    const i32 bx = abs_block_xi % Chunk::NUM_BLOCKS_PER_AXIS;
-    const i32 by = abs_block_yi % Chunk::NUM_BLOCKS_PER_AXIS;
-    const i32 bz = abs_block_zi % Chunk::NUM_BLOCKS_PER_AXIS;
+    const i32 bx = floor_mod(abs_block_xi, Chunk::NUM_BLOCKS_PER_AXIS);
+    const i32 by = floor_mod(abs_block_yi, Chunk::NUM_BLOCKS_PER_AXIS);
+    const i32 bz = floor_mod(abs_block_zi, Chunk::NUM_BLOCKS_PER_AXIS);
+
+    const i32 cx = floor_div(abs_block_xi, Chunk::NUM_BLOCKS_PER_AXIS);
+    const i32 cy = floor_div(abs_block_yi, Chunk::NUM_BLOCKS_PER_AXIS);
+    const i32 cz = floor_div(abs_block_zi, Chunk::NUM_BLOCKS_PER_AXIS);
+
+    // NOTE: Blocks above and below the world and in chunks that are not loaded are treated as air.
+    const Chunk *chunk = find_chunk(cx, cy, cz);
+    if (!chunk)
+        return false;
+
+    std::shared_lock<std::shared_mutex> lock(chunk->mutex);
+    return chunk->is_solid(bx, by, bz);
+}
+
+void
+Landscape::edit_block(i32 abx, i32 aby, i32 abz, BlockType type)
+{
+    constexpr i32 N = Chunk::NUM_BLOCKS_PER_AXIS;
+
+    LT_Assert(aby >= 0 && aby < TOTAL_BLOCKS_Y);
+
+    // NOTE: Only the main thread loads and unloads chunks, so the chunks mutex is not needed, and
+    // the workers keep meshing while the block is edited. Only the locks of the chunks are taken.
+    Chunk *edited_chunk = find_chunk(floor_div(abx, N), aby / N, floor_div(abz, N));
+    if (!edited_chunk)
+        return;
+
+    const i32 edited_bx = floor_mod(abx, N);
+    const i32 edited_by = aby % N;
+    const i32 edited_bz = floor_mod(abz, N);
+    {
+        std::unique_lock<std::shared_mutex> lock(edited_chunk->mutex);
+        edited_chunk->set_block(edited_bx, edited_by, edited_bz, type);
+        // NOTE: Chunks being generated get the blocks of the generator, so their edits are not kept.
+        if (edited_chunk->is_generated)
+        {
+            edited_chunk->edits.record(edited_bx, edited_by, edited_bz, type);
+            edited_chunk->is_dirty = true;
+        }
+    }
+    m_num_edits++;
+
+    // The faces of the block itself and of its six neighbors can change. The texture of the side
+    // faces of the block below changes too, but it is already one of the neighbors.
+    lt_local_persist const i32 OFFSETS[7][3] = {
+        { 0, 0, 0},
+        {-1, 0, 0}, { 1, 0, 0},
+        { 0, 1, 0}, { 0,-1, 0},
+        { 0, 0, 1}, { 0, 0,-1},
+    };
+
+    // Chunks touched by the edit, at most four since the block can only be in a corner, with the
+    // blocks of each chunk whose faces can change. Neighbor chunks are only touched when the
+    // block is on their border.
+    struct TouchedChunk
+    {
+        Chunk *chunk;
+        i32 num_blocks;
+        i32 blocks[7][3];
+    };
+    TouchedChunk touched_chunks[4];
+    i32 num_touched_chunks = 0;
+
+    for (i32 i = 0; i < 7; i++)
+    {
+        const i32 nx = abx + OFFSETS[i][0];
+        const i32 ny = aby + OFFSETS[i][1];
+        const i32 nz = abz + OFFSETS[i][2];
+
+        // NOTE: Chunks being generated are meshed from scratch once their blocks are ready,
+        // and cancelling their request would cancel the generation. Chunks out of view are not rendered.
+        Chunk *chunk = find_chunk_in_view(floor_div(nx, N), floor_div(ny, N), floor_div(nz, N));
+        if (!chunk || !chunk->is_generated)
+            continue;
+
+        TouchedChunk *touched = nullptr;
+        for (i32 j = 0; j < num_touched_chunks; j++)
+            if (touched_chunks[j].chunk == chunk) touched = &touched_chunks[j];
+
+        if (!touched)
+        {
+            LT_Assert(num_touched_chunks < (i32)LT_Count(touched_chunks));
+            touched = &touched_chunks[num_touched_chunks++];
+            touched->chunk = chunk;
+            touched->num_blocks = 0;
+        }
+
+        touched->blocks[touched->num_blocks][0] = floor_mod(nx, N);
+        touched->blocks[touched->num_blocks][1] = floor_mod(ny, N);
+        touched->blocks[touched->num_blocks][2] = floor_mod(nz, N);
+        touched->num_blocks++;
+    }
+
+    // PERFORMANCE: Every touched chunk is gathered once, whatever the number of its blocks whose
+    // faces change, so an edit inside a chunk only gathers that chunk.
+    for (i32 i = 0; i < num_touched_chunks; i++)
+    {
+        const TouchedChunk &touched = touched_chunks[i];
+        Chunk *chunk = touched.chunk;
+
+        // NOTE: A meshing request that is already queued would overwrite the patched mesh
+        // with a mesh that may be older than the edit.
+        {
+            std::unique_lock<std::shared_mutex> lock(chunk->mutex);
+            chunk->cancel_request();
+        }
+
+        gather_padded_chunk(chunk, m_edit_padded.get());
+
+        if (chunk->editable_mesh_index < 0)
+        {
+            // NOTE: The new mesh is built after the block changed, so it is already up to date.
+            acquire_editable_mesh(chunk, *m_edit_padded);
+        }
+        else
+        {
+            EditableChunkMesh *mesh = m_editable_meshes[chunk->editable_mesh_index].mesh.get();
+            for (i32 j = 0; j < touched.num_blocks; j++)
+                mesh->update_block(*m_edit_padded, touched.blocks[j][0], touched.blocks[j][1], touched.blocks[j][2]);
+        }
+
+        // NOTE: Marking the mesh as used right away keeps it from being taken by the other
+        // chunks touched by this edit.
+        m_editable_meshes[chunk->editable_mesh_index].last_edit = m_num_edits;
+    }
+
+    for (i32 i = 0; i < num_touched_chunks; i++)
+        upload_editable_mesh(touched_chunks[i].chunk);
+}
+
+EditableChunkMesh *
+Landscape::acquire_editable_mesh(Chunk *chunk, const PaddedChunk &padded)
+{
+    LT_Assert(chunk->editable_mesh_index == -1);
+
+    // Use a free slot, or take the one of the chunk that was edited the longest time ago.
+    i32 slot_index = 0;
+    for (i32 i = 0; i < MAX_EDITABLE_MESHES; i++)
+    {
+        if (!m_editable_meshes[i].chunk)
+        {
+            slot_index = i;
+            break;
+        }
+        if (m_editable_meshes[i].last_edit < m_editable_meshes[slot_index].last_edit)
+            slot_index = i;
+    }
+
+    EditableMeshSlot &slot = m_editable_meshes[slot_index];
+    if (slot.chunk)
+    {
+        // The evicted chunk keeps its current mesh, but it is meshed again with the current
+        // meshing mode since editable meshes have one quad per face.
+        Chunk *evicted_chunk = slot.chunk;
+        release_editable_mesh(evicted_chunk);
+        queue_chunk_meshing(evicted_chunk);
+    }
+    if (!slot.mesh)
+        slot.mesh = std::make_unique<EditableChunkMesh>();
+
+    slot.chunk = chunk;
+    slot.last_edit = m_num_edits;
+    slot.mesh->build(padded);
+    chunk->editable_mesh_index = slot_index;
+    // NOTE: Editable meshes are always built from the real blocks.
+    chunk->lod = 0;
+
+    // NOTE: Leave room for the quads added by the next edits, so they can be uploaded
+    // without reallocating the vbo.
+    const i32 EDIT_HEADROOM_QUADS = 256;
+    slot.capacity_quads = std::min(slot.mesh->num_quads() + EDIT_HEADROOM_QUADS, Chunk::MAX_QUADS);
+
+    auto &entry = chunk->take_entry();
+    entry.num_quads = slot.mesh->num_quads();
+    entry.is_sorted_by_face = false;
+    pass_chunk_buffer_to_gpu(entry, slot.mesh->vertices, slot.capacity_quads);
+
+    return slot.mesh.get();
+}
+
+void
+Landscape::release_editable_mesh(Chunk *chunk)
+{
+    if (chunk->editable_mesh_index == -1)
+        return;
+
+    EditableMeshSlot &slot = m_editable_meshes[chunk->editable_mesh_index];
+    LT_Assert(slot.chunk == chunk);
+
+    slot.chunk = nullptr;
+    slot.last_edit = 0;
+    chunk->editable_mesh_index = -1;
+}
+
+void
+Landscape::upload_editable_mesh(Chunk *chunk)
+{
+    LT_Assert(chunk->editable_mesh_index >= 0);
 
-    const i32 cx = abs_block_xi / Chunk::NUM_BLOCKS_PER_AXIS;
-    const i32 cy = abs_block_yi / Chunk::NUM_BLOCKS_PER_AXIS;
-    const i32 cz = abs_block_zi / Chunk::NUM_BLOCKS_PER_AXIS;
+    EditableMeshSlot &slot = m_editable_meshes[chunk->editable_mesh_index];
+    EditableChunkMesh *mesh = slot.mesh.get();
+    auto &entry = chunk->take_entry();
+
+    entry.num_quads = mesh->num_quads();
+
+    if (mesh->num_quads() > slot.capacity_quads)
+    {
+        // The edits used all of the headroom, so the whole mesh has to be uploaded again.
+        slot.capacity_quads = std::min(2 * mesh->num_quads(), Chunk::MAX_QUADS);
+        pass_chunk_buffer_to_gpu(entry, mesh->vertices, slot.capacity_quads);
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
+        for (const u16 quad : mesh->dirty_quads)
+        {
+            if (quad >= mesh->num_quads())
+                continue;
 
-    // NOTE: the pointer to the chunk should be available. This is necessary in order to
-    // optimize the chunk generation.
-    LT_Assert(cx < NUM_CHUNKS_X);
-    LT_Assert(cy < NUM_CHUNKS_Y);
-    LT_Assert(cz < NUM_CHUNKS_Z);
-    LT_Assert(chunk_ptrs[cx][cy][cz]);
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex_Chunk) * 4 * quad,
+                            sizeof(Vertex_Chunk) * 4, &mesh->vertices[quad*4]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-    return chunk_ptrs[cx][cy][cz]->blocks[bx][by][bz] != BlockType_Air;
+    mesh->dirty_quads.clear();
 }
 
 void
@@ -328,577 +616,1649 @@ Landscape::initialize_chunks()
 {
     logger.log("Initialize chunks called.");
 
-    for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
-        for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
-            for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
+    auto generated = std::make_unique<GeneratedBlocks>();
+
+    // NOTE: Only the columns in view are loaded, the ones around them are loaded as they come
+    // into view.
+    for (i32 dx = -m_view_distance; dx <= m_view_distance; dx++)
+        for (i32 dz = -m_view_distance; dz <= m_view_distance; dz++)
+        {
+            const i32 column_x = m_center_column_x + dx;
+            const i32 column_z = m_center_column_z + dz;
+            if (!is_column_in_view(column_x, column_z))
+                continue;
+
+            for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
             {
-                const Vec3f chunk_origin = get_chunk_origin(cx, cy, cz);
-                Chunk *chunk = memory::allocate_and_construct<Chunk>(m_chunks_allocator,
-                                                                     chunk_origin, &vao_array);
-                chunk_ptrs[cx][cy][cz] = ChunkPtr(
-                    chunk, std::bind(&Landscape::chunk_deleter, this, _1)
-                );
-                do_chunk_generation_work(chunk);
+                Chunk *chunk = memory::allocate_and_construct<Chunk>(m_chunks_allocator, column_x, cy, column_z,
+                                                                     &vao_array, &m_request_pool);
+                LT_Assert(chunk);
+                // NOTE: The first chunks are generated right away, since there is nothing
+                // to show before they are ready.
+                load_or_generate_chunk(chunk->origin, *generated);
+                chunk->blocks.assign(generated->blocks);
+                chunk->edits = generated->edits;
+                chunk->rebuild_occupancy();
+                chunk->is_generated = true;
+                chunk->is_in_view = true;
+                // NOTE: The camera starts at the center of the landscape.
+                chunk->lod = get_chunk_lod(chunk, center());
+                m_chunk_map.insert(chunk);
             }
+        }
 }
 
-std::vector<Vertex_PLN>
-Landscape::update_chunk_buffer(Chunk *chunk)
+void
+Landscape::gather_padded_chunk(Chunk *chunk, PaddedChunk *padded)
 {
     LT_Assert(chunk);
+    LT_Assert(padded);
+
+    constexpr i32 N = Chunk::NUM_BLOCKS_PER_AXIS;
+
+    const i32 cx = chunk->cx;
+    const i32 cy = chunk->cy;
+    const i32 cz = chunk->cz;
+
+    // NOTE: Edges and corners of the shell are never looked at by the meshers, and neither are
+    // the sides that face the outside of the world or of the view distance, so all of them
+    // are left as air.
+    // Neighbors that are still being generated only contain air, and they mesh this chunk
+    // again once their blocks are ready.
+    const Chunk *left   = find_chunk_in_view(cx-1, cy, cz);
+    const Chunk *right  = find_chunk_in_view(cx+1, cy, cz);
+    const Chunk *bottom = find_chunk_in_view(cx, cy-1, cz);
+    const Chunk *top    = find_chunk_in_view(cx, cy+1, cz);
+    const Chunk *back   = find_chunk_in_view(cx, cy, cz-1);
+    const Chunk *front  = find_chunk_in_view(cx, cy, cz+1);
+
+    ChunkReadLocks locks;
+    locks.add(chunk);
+    locks.add(left);
+    locks.add(right);
+    locks.add(bottom);
+    locks.add(top);
+    locks.add(back);
+    locks.add(front);
+    locks.lock();
+
+    std::memset(padded->blocks, BlockType_Air, sizeof(padded->blocks));
+    std::memset(padded->occupancy_x, 0, sizeof(padded->occupancy_x));
+    std::memset(padded->occupancy_z, 0, sizeof(padded->occupancy_z));
+    padded->base_aby = cy*N;
+
+    BlockType row[N];
+    for (i32 bx = 0; bx < N; bx++)
+        for (i32 by = 0; by < N; by++)
+        {
+            chunk->blocks.get_row_z(bx, by, row);
+            std::copy(row, row + N, &padded->blocks[bx+1][by+1][1]);
+        }
+
+    for (i32 i = 0; i < N; i++)
+        for (i32 j = 0; j < N; j++)
+        {
+            padded->occupancy_x[i+1][j+1] = chunk->occupancy_x[i][j];
+            padded->occupancy_z[i+1][j+1] = chunk->occupancy_z[i][j];
+        }
 
-    const i32 cx = (i32)(chunk->origin.x - origin.x) / Chunk::SIZE;
-    const i32 cy = (i32)(chunk->origin.y - origin.y) / Chunk::SIZE;
-    const i32 cz = (i32)(chunk->origin.z - origin.z) / Chunk::SIZE;
+    if (left)
+    {
+        for (i32 by = 0; by < N; by++)
+        {
+            left->blocks.get_row_z(N-1, by, row);
+            std::copy(row, row + N, &padded->blocks[0][by+1][1]);
+        }
+        for (i32 by = 0; by < N; by++)
+            padded->occupancy_z[0][by+1] = left->occupancy_z[N-1][by];
+    }
+    if (right)
+    {
+        for (i32 by = 0; by < N; by++)
+        {
+            right->blocks.get_row_z(0, by, row);
+            std::copy(row, row + N, &padded->blocks[N+1][by+1][1]);
+        }
+        for (i32 by = 0; by < N; by++)
+            padded->occupancy_z[N+1][by+1] = right->occupancy_z[0][by];
+    }
+    if (bottom)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+        {
+            bottom->blocks.get_row_z(bx, N-1, row);
+            std::copy(row, row + N, &padded->blocks[bx+1][0][1]);
+        }
+        for (i32 i = 0; i < N; i++)
+        {
+            padded->occupancy_x[0][i+1] = bottom->occupancy_x[N-1][i];
+            padded->occupancy_z[i+1][0] = bottom->occupancy_z[i][N-1];
+        }
+    }
+    if (top)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+        {
+            top->blocks.get_row_z(bx, 0, row);
+            std::copy(row, row + N, &padded->blocks[bx+1][N+1][1]);
+        }
+        for (i32 i = 0; i < N; i++)
+        {
+            padded->occupancy_x[N+1][i+1] = top->occupancy_x[0][i];
+            padded->occupancy_z[i+1][N+1] = top->occupancy_z[i][0];
+        }
+    }
+    if (back)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+            for (i32 by = 0; by < N; by++)
+                padded->blocks[bx+1][by+1][0] = back->blocks.get(bx, by, N-1);
+        for (i32 by = 0; by < N; by++)
+            padded->occupancy_x[by+1][0] = back->occupancy_x[by][N-1];
+    }
+    if (front)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+            for (i32 by = 0; by < N; by++)
+                padded->blocks[bx+1][by+1][N+1] = front->blocks.get(bx, by, 0);
+        for (i32 by = 0; by < N; by++)
+            padded->occupancy_x[by+1][N+1] = front->occupancy_x[by][0];
+    }
+}
 
-    // PERFORMANCE: In order to improve performance, since many threads will be calling this function,
-    // introduce a arena to allocate this vector from. However this introduces complexity by creating
-    // a custom allocator with variable block sizes.
-    std::vector<Vertex_PLN> chunk_vertices;
+void
+Landscape::update_chunk_buffer(const PaddedChunk &padded, MeshingMode mode, ChunkVertexBuffer &vertices)
+{
+    vertices.clear();
 
-    // If chunk is not outdated, avoid updating the vertexes.
-    const Vec3f pos_x_offset(Chunk::BLOCK_SIZE, 0, 0);
-    const Vec3f pos_y_offset(0, Chunk::BLOCK_SIZE, 0);
-    const Vec3f pos_z_offset(0, 0, Chunk::BLOCK_SIZE);
+    switch (mode)
+    {
+    case MeshingMode_Naive: mesh_chunk_naive(padded, vertices); break;
+    case MeshingMode_Greedy: mesh_chunk_greedy(padded, vertices); break;
+    case MeshingMode_Binary: mesh_chunk_binary(padded, vertices); break;
+    default: LT_Unreachable;
+    }
+}
 
-    for (i32 bx = 0; bx < Chunk::NUM_BLOCKS_PER_AXIS; bx++)
-        for (i32 by = 0; by < Chunk::NUM_BLOCKS_PER_AXIS; by++)
-            for (i32 bz = 0; bz < Chunk::NUM_BLOCKS_PER_AXIS; bz++)
-            {
-                // Absolute indexes for the block.
-                const i32 abx = cx*Chunk::NUM_BLOCKS_PER_AXIS + bx;
-                const i32 aby = cy*Chunk::NUM_BLOCKS_PER_AXIS + by;
-                const i32 abz = cz*Chunk::NUM_BLOCKS_PER_AXIS + bz;
+void
+Landscape::set_meshing_mode(MeshingMode mode)
+{
+    LT_Assert(mode >= 0 && mode < MeshingMode_Count);
+    if (mode == m_meshing_mode)
+        return;
 
-                const BlockType block_type = chunk->blocks[bx][by][bz];
-                if (block_type == BlockType_Air)
-                    continue;
+    m_meshing_mode = mode;
+    remesh_all_chunks();
+}
 
-                // Where the block is located in world space.
-                const Vec3f block_origin = get_world_coords(*chunk, bx, by, bz);
-
-                // All possible vertices of the block.
-                const Vec3f left_bottom_back = block_origin;
-                const Vec3f left_bottom_front = left_bottom_back + pos_z_offset;
-                const Vec3f left_top_front = left_bottom_front + pos_y_offset;
-                const Vec3f left_top_back = left_top_front - pos_z_offset;
-                const Vec3f right_bottom_back = left_bottom_back + pos_x_offset;
-                const Vec3f right_top_back = right_bottom_back + pos_y_offset;
-                const Vec3f right_top_front = right_top_back + pos_z_offset;
-                const Vec3f right_bottom_front = right_top_front - pos_y_offset;
-
-                // Check faces to render
-                const bool should_render_left_face =
-                    (abx == 0) ||
-                    !block_exists(abx-1, aby, abz);
-
-                const bool should_render_right_face =
-                    (abx == TOTAL_BLOCKS_X-1) ||
-                    !block_exists(abx+1, aby, abz);
-
-                const bool should_render_top_face =
-                    (aby == TOTAL_BLOCKS_Y-1) ||
-                    !block_exists(abx, aby+1, abz);
-
-                const bool should_render_bottom_face =
-                    (aby == 0) ||
-                    !block_exists(abx, aby-1, abz);
-
-                const bool should_render_front_face =
-                    (abz == TOTAL_BLOCKS_Z-1) ||
-                    !block_exists(abx, aby, abz+1);
-
-                const bool should_render_back_face =
-                    (abz == 0) ||
-                    !block_exists(abx, aby, abz-1);
-
-                // TODO: Figure out a better way of mixing and matching different
-                // block textures.
-                u16 sides_layer = -1;
-                u16 top_layer = -1;
-                u16 bottom_layer = -1;
-                if (aby > Landscape::TOTAL_BLOCKS_Y - 30)
-                {
-                    sides_layer = (should_render_top_face)
-                        ? Textures16x16_Snow_Sides_Top
-                        : Textures16x16_Snow_Sides;
-                    top_layer = Textures16x16_Snow_Top;
-                    bottom_layer = Textures16x16_Snow_Bottom;
-                }
-                else
-                {
-                    sides_layer = (should_render_top_face)
-                        ? Textures16x16_Earth_Sides_Top
-                        : Textures16x16_Earth_Sides;
-                    top_layer = Textures16x16_Earth_Top;
-                    bottom_layer = Textures16x16_Earth_Bottom;
-                }
+void
+Landscape::set_lod_downsampling(LodDownsampling downsampling)
+{
+    LT_Assert(downsampling >= 0 && downsampling < LodDownsampling_Count);
+    if (downsampling == m_lod_downsampling)
+        return;
 
-                // Left face ------------------------------------------------------
-                if (should_render_left_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = left_bottom_back;
-                    v1.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v1.normal   = Vec3f(-1, 0, 0);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = left_bottom_front;
-                    v2.tex_coords_layer = Vec3f(1, 0, sides_layer);
-                    v2.normal   = Vec3f(-1, 0, 0);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = left_top_front;
-                    v3.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v3.normal   = Vec3f(-1, 0, 0);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = left_top_front;
-                    v4.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v4.normal   = Vec3f(-1, 0, 0);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = left_top_back;
-                    v5.tex_coords_layer = Vec3f(0, 1, sides_layer);
-                    v5.normal   = Vec3f(-1, 0, 0);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = left_bottom_back;
-                    v6.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v6.normal   = Vec3f(-1, 0, 0);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-                // Right face -----------------------------------------------------
-                if (should_render_right_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = right_bottom_back;
-                    v1.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v1.normal   = Vec3f(1, 0, 0);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = right_top_back;
-                    v2.tex_coords_layer = Vec3f(0, 1, sides_layer);
-                    v2.normal   = Vec3f(1, 0, 0);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = right_top_front;
-                    v3.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v3.normal     = Vec3f(1, 0, 0);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = right_top_front;
-                    v4.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v4.normal     = Vec3f(1, 0, 0);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = right_bottom_front;
-                    v5.tex_coords_layer = Vec3f(1, 0, sides_layer);
-                    v5.normal   = Vec3f(1, 0, 0);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = right_bottom_back;
-                    v6.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v6.normal   = Vec3f(1, 0, 0);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-                // Top face --------------------------------------------------------
-                if (should_render_top_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = left_top_front;
-                    v1.tex_coords_layer = Vec3f(0, 0, top_layer);
-                    v1.normal   = Vec3f(0, 1, 0);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = right_top_front;
-                    v2.tex_coords_layer = Vec3f(1, 0, top_layer);
-                    v2.normal   = Vec3f(0, 1, 0);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = right_top_back;
-                    v3.tex_coords_layer = Vec3f(1, 1, top_layer);
-                    v3.normal   = Vec3f(0, 1, 0);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = right_top_back;
-                    v4.tex_coords_layer = Vec3f(1, 1, top_layer);
-                    v4.normal   = Vec3f(0, 1, 0);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = left_top_back;
-                    v5.tex_coords_layer = Vec3f(0, 1, top_layer);
-                    v5.normal   = Vec3f(0, 1, 0);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = left_top_front;
-                    v6.tex_coords_layer = Vec3f(0, 0, top_layer);
-                    v6.normal   = Vec3f(0, 1, 0);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-                // Bottom face -----------------------------------------------------
-                if (should_render_bottom_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = left_bottom_back;
-                    v1.tex_coords_layer = Vec3f(0, 0, bottom_layer);
-                    v1.normal   = Vec3f(0, -1, 0);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = right_bottom_back;
-                    v2.tex_coords_layer = Vec3f(1, 0, bottom_layer);
-                    v2.normal   = Vec3f(0, -1, 0);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = right_bottom_front;
-                    v3.tex_coords_layer = Vec3f(1, 1, bottom_layer);
-                    v3.normal   = Vec3f(0, -1, 0);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = right_bottom_front;
-                    v4.tex_coords_layer = Vec3f(1, 1, bottom_layer);
-                    v4.normal   = Vec3f(0, -1, 0);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = left_bottom_front;
-                    v5.tex_coords_layer = Vec3f(0, 1, bottom_layer);
-                    v5.normal   = Vec3f(0, -1, 0);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = left_bottom_back;
-                    v6.tex_coords_layer = Vec3f(0, 0, bottom_layer);
-                    v6.normal   = Vec3f(0, -1, 0);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-                // Front face -------------------------------------------------------
-                if (should_render_front_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = left_bottom_front;
-                    v1.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v1.normal   = Vec3f(0, 0, 1);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = right_bottom_front;
-                    v2.tex_coords_layer = Vec3f(1, 0, sides_layer);
-                    v2.normal   = Vec3f(0, 0, 1);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = right_top_front;
-                    v3.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v3.normal   = Vec3f(0, 0, 1);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = right_top_front;
-                    v4.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v4.normal   = Vec3f(0, 0, 1);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = left_top_front;
-                    v5.tex_coords_layer = Vec3f(0, 1, sides_layer);
-                    v5.normal   = Vec3f(0, 0, 1);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = left_bottom_front;
-                    v6.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v6.normal   = Vec3f(0, 0, 1);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-                // Back face --------------------------------------------------------
-                if (should_render_back_face)
-                {
-                    Vertex_PLN v1 = {};
-                    v1.position   = right_bottom_back;
-                    v1.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v1.normal   = Vec3f(0, 0, -1);
-
-                    Vertex_PLN v2 = {};
-                    v2.position   = left_bottom_back;
-                    v2.tex_coords_layer = Vec3f(1, 0, sides_layer);
-                    v2.normal   = Vec3f(0, 0, -1);
-
-                    Vertex_PLN v3 = {};
-                    v3.position   = left_top_back;
-                    v3.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v3.normal   = Vec3f(0, 0, -1);
-
-                    Vertex_PLN v4 = {};
-                    v4.position   = left_top_back;
-                    v4.tex_coords_layer = Vec3f(1, 1, sides_layer);
-                    v4.normal   = Vec3f(0, 0, -1);
-
-                    Vertex_PLN v5 = {};
-                    v5.position   = right_top_back;
-                    v5.tex_coords_layer = Vec3f(0, 1, sides_layer);
-                    v5.normal   = Vec3f(0, 0, -1);
-
-                    Vertex_PLN v6 = {};
-                    v6.position   = right_bottom_back;
-                    v6.tex_coords_layer = Vec3f(0, 0, sides_layer);
-                    v6.normal   = Vec3f(0, 0, -1);
-
-                    chunk_vertices.push_back(v1);
-                    chunk_vertices.push_back(v2);
-                    chunk_vertices.push_back(v3);
-                    chunk_vertices.push_back(v4);
-                    chunk_vertices.push_back(v5);
-                    chunk_vertices.push_back(v6);
-                }
-            }
-    return chunk_vertices;
+    m_lod_downsampling = downsampling;
+    remesh_all_chunks();
+}
+
+void
+Landscape::remesh_all_chunks()
+{
+    m_remesh_cursor = 0;
+    m_remesh_center_x = m_center_column_x;
+    m_remesh_center_z = m_center_column_z;
+}
+
+void
+Landscape::debug_compare_meshing_modes()
+{
+    using clock = std::chrono::high_resolution_clock;
+    lt_local_persist const char *MODE_NAMES[MeshingMode_Count] = {"naive", "greedy", "binary"};
+    lt_local_persist const char *DOWNSAMPLING_NAMES[LodDownsampling_Count] = {"any solid", "majority"};
+
+    usize num_triangles[MeshingMode_Count] = {};
+    f64 meshing_ms[MeshingMode_Count] = {};
+
+    f64 gather_ms = 0.0;
+
+    // NOTE: Only the meshing kernels are timed per mode, since gathering the padded chunk
+    // is the same work for all of them.
+    auto padded = std::make_unique<PaddedChunk>();
+    auto lod_padded = std::make_unique<PaddedChunk>();
+    ChunkVertexBuffer vertices;
+
+    // Triangles of the current meshing mode at every level of detail, with each downsampling.
+    usize num_lod_triangles[LodDownsampling_Count][NUM_LODS] = {};
+
+    i32 num_chunks = 0;
+
+    chunks_mutex.lock_high_priority(); // LOCK
+
+    // NOTE: Only the chunks that are rendered are compared.
+    for (i32 i = 0; i < m_chunk_map.num_chunks(); i++)
+    {
+        Chunk *chunk = m_chunk_map.chunk_at(i);
+        if (!chunk->is_in_view || !chunk->is_generated)
+            continue;
+
+        num_chunks++;
+
+        const auto gather_start = clock::now();
+        gather_padded_chunk(chunk, padded.get());
+        gather_ms += std::chrono::duration<f64, std::milli>(clock::now() - gather_start).count();
+
+        for (i32 mode = 0; mode < MeshingMode_Count; mode++)
+        {
+            const auto start = clock::now();
+            update_chunk_buffer(*padded, static_cast<MeshingMode>(mode), vertices);
+            meshing_ms[mode] += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+            num_triangles[mode] += 2 * (vertices.size() / 4);
+        }
+
+        for (i32 downsampling = 0; downsampling < LodDownsampling_Count; downsampling++)
+            for (i32 lod = 0; lod < NUM_LODS; lod++)
+            {
+                *lod_padded = *padded;
+                downsample_padded_chunk(*lod_padded, lod, static_cast<LodDownsampling>(downsampling));
+                update_chunk_buffer(*lod_padded, m_meshing_mode, vertices);
+                num_lod_triangles[downsampling][lod] += 2 * (vertices.size() / 4);
+            }
+    }
+
+    chunks_mutex.unlock_high_priority(); // UNLOCK
+
+    logger.log("Meshing comparison for seed ", m_seed, " (", num_chunks, " chunks, ",
+               gather_ms, " ms gathering padded chunks):");
+    for (i32 mode = 0; mode < MeshingMode_Count; mode++)
+    {
+        logger.log("    ", MODE_NAMES[mode], ": ", num_triangles[mode], " triangles (",
+                   (100.0 * num_triangles[mode]) / std::max<usize>(num_triangles[MeshingMode_Naive], 1),
+                   "% of naive) meshed in ", meshing_ms[mode], " ms");
+    }
+    for (i32 downsampling = 0; downsampling < LodDownsampling_Count; downsampling++)
+        for (i32 lod = 1; lod < NUM_LODS; lod++)
+        {
+            const usize *triangles = num_lod_triangles[downsampling];
+            logger.log("    ", MODE_NAMES[m_meshing_mode], " with lod ", lod, " (", DOWNSAMPLING_NAMES[downsampling],
+                       "): ", triangles[lod], " triangles (",
+                       (100.0 * triangles[lod]) / std::max<usize>(triangles[0], 1), "% of lod 0)");
+        }
+}
+
+Landscape::MeshingStats
+Landscape::meshing_stats() const
+{
+    MeshingStats stats;
+    stats.num_chunks_meshed = m_num_chunks_meshed;
+    stats.num_allocations = g_chunk_vertex_allocations.num_allocations.load(std::memory_order_relaxed);
+    stats.num_cache_hits = m_mesh_cache.num_hits;
+    stats.num_cache_misses = m_mesh_cache.num_misses;
+    stats.cache_used_bytes = m_mesh_cache.used_bytes();
+    stats.cache_max_bytes = m_mesh_cache.max_bytes();
+    return stats;
+}
+
+lt_internal inline void
+get_noise_batch(struct osn_context *ctx, const f64 *x, const f64 *y, f64 *out, i32 count)
+{
+    open_simplex_noise2_batch(ctx, x, y, out, count);
+}
+
+lt_internal inline void
+get_noise_batch(struct osn_context *ctx, const f32 *x, const f32 *y, f32 *out, i32 count)
+{
+    open_simplex_noise2_batch_f32(ctx, x, y, out, count);
+}
+
+//
+// Evaluates the fbm at count points, one octave at a time so the noise of each octave is computed
+// for all of the points at once. When NUM_OCTAVES is zero the number of octaves is only known at
+// runtime. With f64 the results are the same as evaluating every point on its own.
+//
+template<typename T, i32 MAX_POINTS, i32 NUM_OCTAVES>
+lt_internal void
+get_fbm_batch(struct osn_context *ctx, const T *xs, const T *ys, i32 count, f64 amplitude,
+              f64 frequency, i32 num_octaves, f64 lacunarity, f64 gain, T *fbm)
+{
+    LT_Assert(count <= MAX_POINTS);
+    const i32 octaves = (NUM_OCTAVES > 0) ? NUM_OCTAVES : num_octaves;
+
+    T x[MAX_POINTS];
+    T y[MAX_POINTS];
+    T noise[MAX_POINTS];
+
+    for (i32 i = 0; i < count; i++)
+        fbm[i] = 0;
+
+    for (i32 octave = 0; octave < octaves; octave++)
+    {
+        const T f = (T)frequency;
+        const T a = (T)amplitude;
+        for (i32 i = 0; i < count; i++)
+        {
+            x[i] = f*xs[i];
+            y[i] = f*ys[i];
+        }
+        get_noise_batch(ctx, x, y, noise, count);
+        for (i32 i = 0; i < count; i++)
+            fbm[i] += a * noise[i];
+
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+}
+
+template<typename T, i32 MAX_POINTS>
+lt_internal void
+get_fbm_batch(struct osn_context *ctx, const T *xs, const T *ys, i32 count, f64 amplitude,
+              f64 frequency, i32 num_octaves, f64 lacunarity, f64 gain, T *fbm)
+{
+#define FBM_CASE(n) case n: \
+        get_fbm_batch<T, MAX_POINTS, n>(ctx, xs, ys, count, amplitude, frequency, num_octaves, \
+                                        lacunarity, gain, fbm); \
+        break
+    switch (num_octaves)
+    {
+        FBM_CASE(1);
+        FBM_CASE(2);
+        FBM_CASE(3);
+        FBM_CASE(4);
+        FBM_CASE(5);
+        FBM_CASE(6);
+        FBM_CASE(7);
+        FBM_CASE(8);
+    default:
+        get_fbm_batch<T, MAX_POINTS, 0>(ctx, xs, ys, count, amplitude, frequency, num_octaves,
+                                        lacunarity, gain, fbm);
+        break;
+    }
+#undef FBM_CASE
+}
+
+// Catmull-Rom spline going through p1 (t = 0) and p2 (t = 1).
+lt_internal inline f64
+catmull_rom(f64 p0, f64 p1, f64 p2, f64 p3, f64 t)
+{
+    return 0.5 * ((2.0*p1) +
+                  (-p0 + p2) * t +
+                  (2.0*p0 - 5.0*p1 + 4.0*p2 - p3) * t*t +
+                  (-p0 + 3.0*p1 - 3.0*p2 + p3) * t*t*t);
+}
+
+void
+Landscape::set_noise_precision(NoisePrecision precision)
+{
+    if (precision == m_noise_precision)
+        return;
+
+    m_noise_precision = precision;
+    // NOTE: Only columns generated from now on use the new precision.
+    invalidate_column_heightmaps();
+}
+
+bool
+Landscape::set_noise_sampling(NoiseSampling sampling, i32 lattice_spacing)
+{
+    LT_Assert(lattice_spacing > 0 && lattice_spacing <= Chunk::NUM_BLOCKS_PER_AXIS);
+    LT_Assert(Chunk::NUM_BLOCKS_PER_AXIS % lattice_spacing == 0);
+
+    NoiseSamplingSettings settings;
+    settings.sampling = sampling;
+    settings.lattice_spacing = lattice_spacing;
+
+    // NOTE: The error depends on the terrain parameters, so it is measured on the terrain
+    // instead of being assumed from the spacing.
+    if (sampling != NoiseSampling_Full && lattice_spacing > 1)
+    {
+        const i32 max_error = measure_noise_sampling_error(settings).max_error;
+        if (max_error > MAX_NOISE_SAMPLING_ERROR)
+        {
+            logger.error("Noise sampling every ", lattice_spacing, " blocks is off by up to ", max_error,
+                         " blocks, above ", MAX_NOISE_SAMPLING_ERROR, " block(s), keeping the current sampling.");
+            return false;
+        }
+    }
+
+    m_noise_sampling = settings;
+    // NOTE: Only columns generated from now on use the new sampling.
+    invalidate_column_heightmaps();
+    return true;
+}
+
+void
+Landscape::invalidate_column_heightmaps()
+{
+    for (i32 x = 0; x < MAX_COLUMNS_PER_AXIS; x++)
+        for (i32 z = 0; z < MAX_COLUMNS_PER_AXIS; z++)
+        {
+            std::lock_guard<std::mutex> lock(m_column_heightmaps[x][z].mutex);
+            m_column_heightmaps[x][z].is_valid = false;
+        }
+}
+
+void
+Landscape::evaluate_fbm(const f64 *xs, const f64 *ys, i32 count, f64 *fbm)
+{
+    if (m_noise_precision == NoisePrecision_F32)
+    {
+        f32 xs_f32[MAX_NOISE_POINTS], ys_f32[MAX_NOISE_POINTS], fbm_f32[MAX_NOISE_POINTS];
+        for (i32 i = 0; i < count; i++)
+        {
+            xs_f32[i] = xs[i];
+            ys_f32[i] = ys[i];
+        }
+        get_fbm_batch<f32, MAX_NOISE_POINTS>(m_simplex_ctx, xs_f32, ys_f32, count, m_amplitude, m_frequency,
+                                             m_num_octaves, m_lacunarity, m_gain, fbm_f32);
+        for (i32 i = 0; i < count; i++)
+            fbm[i] = fbm_f32[i];
+    }
+    else
+    {
+        get_fbm_batch<f64, MAX_NOISE_POINTS>(m_simplex_ctx, xs, ys, count, m_amplitude, m_frequency,
+                                             m_num_octaves, m_lacunarity, m_gain, fbm);
+    }
+}
+
+i32
+Landscape::sample_column_noise(i32 column_x, i32 column_z, NoiseSamplingSettings settings,
+                               f64 noise[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS])
+{
+    constexpr i32 N = Chunk::NUM_BLOCKS_PER_AXIS;
+
+    const f64 base_x = (f64)column_x*Chunk::SIZE;
+    const f64 base_z = (f64)column_z*Chunk::SIZE;
+
+    f64 xs[MAX_NOISE_POINTS], ys[MAX_NOISE_POINTS], values[MAX_NOISE_POINTS];
+
+    if (settings.sampling == NoiseSampling_Full || settings.lattice_spacing == 1)
+    {
+        for (i32 x = 0; x < N; x++)
+            for (i32 z = 0; z < N; z++)
+            {
+                xs[x*N + z] = base_x + Chunk::BLOCK_SIZE*x;
+                ys[x*N + z] = base_z + Chunk::BLOCK_SIZE*z;
+            }
+        evaluate_fbm(xs, ys, N*N, values);
+
+        for (i32 x = 0; x < N; x++)
+            for (i32 z = 0; z < N; z++)
+                noise[x][z] = values[x*N + z];
+        return N*N;
+    }
+
+    // The lattice covers the column including its far border, which is shared with the next
+    // column, so neighboring columns interpolate the same values along their seam. Bicubic
+    // interpolation also needs one more lattice point on every side.
+    const i32 spacing = settings.lattice_spacing;
+    const i32 border = (settings.sampling == NoiseSampling_Bicubic) ? 1 : 0;
+    const i32 num_cells = N / spacing;
+    const i32 lattice_size = num_cells + 1 + 2*border;
+    const i32 num_points = lattice_size*lattice_size;
+    LT_Assert(num_points <= MAX_NOISE_POINTS);
+
+    for (i32 i = 0; i < lattice_size; i++)
+        for (i32 j = 0; j < lattice_size; j++)
+        {
+            xs[i*lattice_size + j] = base_x + Chunk::BLOCK_SIZE*spacing*(i - border);
+            ys[i*lattice_size + j] = base_z + Chunk::BLOCK_SIZE*spacing*(j - border);
+        }
+    evaluate_fbm(xs, ys, num_points, values);
+
+    auto lattice = [&](i32 i, i32 j) -> f64 {
+        return values[(i + border)*lattice_size + (j + border)];
+    };
+
+    for (i32 x = 0; x < N; x++)
+        for (i32 z = 0; z < N; z++)
+        {
+            const i32 i = x / spacing;
+            const i32 j = z / spacing;
+            const f64 tx = (f64)(x % spacing) / spacing;
+            const f64 tz = (f64)(z % spacing) / spacing;
+
+            if (settings.sampling == NoiseSampling_Bilinear)
+            {
+                const f64 v0 = lattice(i, j) + (lattice(i, j+1) - lattice(i, j)) * tz;
+                const f64 v1 = lattice(i+1, j) + (lattice(i+1, j+1) - lattice(i+1, j)) * tz;
+                noise[x][z] = v0 + (v1 - v0) * tx;
+            }
+            else
+            {
+                f64 rows[4];
+                for (i32 k = 0; k < 4; k++)
+                {
+                    rows[k] = catmull_rom(lattice(i-1+k, j-1), lattice(i-1+k, j),
+                                          lattice(i-1+k, j+1), lattice(i-1+k, j+2), tz);
+                }
+                noise[x][z] = catmull_rom(rows[0], rows[1], rows[2], rows[3], tx);
+            }
+        }
+
+    return num_points;
+}
+
+// Rescales a noise value into the absolute y index of the highest solid block.
+lt_internal i32
+get_height_from_noise(f64 noise, i32 max_height)
+{
+    // Rescale noise values into 0 -> 1 range
+    const f64 min = -1.0;
+    const f64 max = 1.0;
+    const f64 normalized_height = (noise + (max - min)) / (2*max - min);
+
+#define EPSILON 0.001
+    LT_Assert(normalized_height <= (1.0 + EPSILON) && normalized_height >= -EPSILON);
+#undef EPSILON
+
+    return std::round((f64)max_height * normalized_height);
+}
+
+void
+Landscape::get_column_heightmap(i32 column_x, i32 column_z,
+                                i32 heights[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS])
+{
+    // NOTE: Loaded columns are less than MAX_COLUMNS_PER_AXIS apart along each axis, so they never
+    // share a heightmap.
+    ColumnHeightmap &heightmap = m_column_heightmaps[floor_mod(column_x, MAX_COLUMNS_PER_AXIS)]
+                                                    [floor_mod(column_z, MAX_COLUMNS_PER_AXIS)];
+
+    // NOTE: The worker threads generate the chunks of a column at the same time, the first one
+    // computes the heights while the others wait for them.
+    std::lock_guard<std::mutex> lock(heightmap.mutex);
+
+    if (heightmap.is_valid && heightmap.column_x == column_x && heightmap.column_z == column_z)
+    {
+        std::memcpy(heights, heightmap.heights, sizeof(heightmap.heights));
+        return;
+    }
+
+    f64 noise[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS];
+    sample_column_noise(column_x, column_z, m_noise_sampling, noise);
+
+    for (i32 x = 0; x < Chunk::NUM_BLOCKS_PER_AXIS; x++)
+        for (i32 z = 0; z < Chunk::NUM_BLOCKS_PER_AXIS; z++)
+            heightmap.heights[x][z] = get_height_from_noise(noise[x][z], TOTAL_BLOCKS_Y-1);
+
+    heightmap.column_x = column_x;
+    heightmap.column_z = column_z;
+    heightmap.is_valid = true;
+    std::memcpy(heights, heightmap.heights, sizeof(heightmap.heights));
+}
+
+Landscape::NoiseSamplingError
+Landscape::measure_noise_sampling_error(NoiseSamplingSettings settings)
+{
+    using clock = std::chrono::high_resolution_clock;
+
+    NoiseSamplingSettings full;
+    full.sampling = NoiseSampling_Full;
+    full.lattice_spacing = 1;
+
+    f64 full_noise[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS];
+    f64 sampled_noise[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS];
+
+    NoiseSamplingError result = {};
+
+    // NOTE: The columns in view are compared, so the error is measured on the terrain that is
+    // being looked at.
+    for (i32 column_x = m_center_column_x - m_view_distance; column_x <= m_center_column_x + m_view_distance; column_x++)
+        for (i32 column_z = m_center_column_z - m_view_distance; column_z <= m_center_column_z + m_view_distance; column_z++)
+        {
+            if (!is_column_in_view(column_x, column_z))
+                continue;
+
+            auto start = clock::now();
+            result.num_full_points += sample_column_noise(column_x, column_z, full, full_noise);
+            result.full_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+
+            start = clock::now();
+            result.num_sampled_points += sample_column_noise(column_x, column_z, settings, sampled_noise);
+            result.sampled_ms += std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+
+            for (i32 x = 0; x < Chunk::NUM_BLOCKS_PER_AXIS; x++)
+                for (i32 z = 0; z < Chunk::NUM_BLOCKS_PER_AXIS; z++)
+                {
+                    const i32 error = std::abs(get_height_from_noise(full_noise[x][z], TOTAL_BLOCKS_Y-1) -
+                                               get_height_from_noise(sampled_noise[x][z], TOTAL_BLOCKS_Y-1));
+                    result.max_error = std::max(result.max_error, error);
+                    result.sum_error += error;
+                    result.num_heights++;
+                    if (error > 0) result.num_wrong_heights++;
+                }
+        }
+
+    return result;
+}
+
+void
+Landscape::debug_measure_noise_sampling_error()
+{
+    lt_local_persist const char *SAMPLING_NAMES[] = {"full", "bilinear", "bicubic"};
+
+    for (NoiseSampling sampling : {NoiseSampling_Bilinear, NoiseSampling_Bicubic})
+        for (i32 spacing = 2; spacing <= Chunk::NUM_BLOCKS_PER_AXIS/2; spacing *= 2)
+        {
+            NoiseSamplingSettings settings;
+            settings.sampling = sampling;
+            settings.lattice_spacing = spacing;
+            const NoiseSamplingError error = measure_noise_sampling_error(settings);
+
+            logger.log("Noise sampling error for ", SAMPLING_NAMES[sampling], " every ", spacing,
+                       " blocks, over ", error.num_heights, " heights:");
+            logger.log("    max error: ", error.max_error, " blocks, mean error: ",
+                       (f64)error.sum_error / error.num_heights, " blocks, ",
+                       (100.0 * error.num_wrong_heights) / error.num_heights, "% of the heights differ");
+            logger.log("    noise points: ", error.num_sampled_points, " (",
+                       (100.0 * error.num_sampled_points) / error.num_full_points, "% of full), ",
+                       error.sampled_ms, " ms (full resolution ", error.full_ms, " ms)");
+
+            if (error.max_error > MAX_NOISE_SAMPLING_ERROR)
+                logger.log("    above the maximum error of ", MAX_NOISE_SAMPLING_ERROR, " block(s).");
+        }
+}
+
+void
+Landscape::pass_chunk_buffer_to_gpu(const VAOArray::Entry &entry, const ChunkVertexBuffer &buf,
+                                    i32 capacity_quads)
+{
+    LT_Assert(entry.num_quads <= Chunk::MAX_QUADS);
+
+    glBindVertexArray(entry.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
+    if (capacity_quads == 0)
+    {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex_Chunk) * buf.size(), buf.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        LT_Assert(buf.size() <= (usize)capacity_quads * 4);
+        // NOTE: Editable meshes are patched often, so the buffer is not marked as static.
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex_Chunk) * 4 * capacity_quads, nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex_Chunk) * buf.size(), buf.data());
+    }
+
+    // Every chunk shares the same index buffer, the binding is stored in its vao.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vao_array.quad_ebo);
+
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_BYTE, sizeof(Vertex_Chunk),
+                           (const void*)offsetof(Vertex_Chunk, x));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_BYTE, sizeof(Vertex_Chunk),
+                           (const void*)offsetof(Vertex_Chunk, u));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(Vertex_Chunk),
+                           (const void*)offsetof(Vertex_Chunk, layer));
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void
+Landscape::generate()
+{
+    logger.log("Generating landscape");
+
+    // NOTE: The blocks of every chunk were already generated when the chunks were initialized,
+    // so only their meshes are missing.
+    chunks_mutex.lock_high_priority(); // LOCK
+
+    for (i32 i = 0; i < m_chunk_map.num_chunks(); i++)
+        queue_chunk_meshing(m_chunk_map.chunk_at(i));
+
+    chunks_mutex.unlock_high_priority(); // UNLOCK
+}
+
+void
+Landscape::do_chunk_generation_work(Vec3f chunk_origin, TerrainMode mode,
+                                    BlockType blocks[Chunk::NUM_BLOCKS_PER_AXIS]
+                                                    [Chunk::NUM_BLOCKS_PER_AXIS]
+                                                    [Chunk::NUM_BLOCKS_PER_AXIS])
+{
+    constexpr i32 N = Chunk::NUM_BLOCKS_PER_AXIS;
+
+    const i32 cy = static_cast<i32>(std::floor(chunk_origin.y / Chunk::SIZE));
+    const i32 column_x = static_cast<i32>(std::floor(chunk_origin.x / Chunk::SIZE));
+    const i32 column_z = static_cast<i32>(std::floor(chunk_origin.z / Chunk::SIZE));
+    const i32 base_aby = cy*N;
+
+    i32 heights[N][N];
+    get_column_heightmap(column_x, column_z, heights);
+
+    if (mode == TerrainMode_Heightmap)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+            for (i32 bz = 0; bz < N; bz++)
+                for (i32 by = 0; by < N; by++)
+                {
+                    const bool is_terrain = (base_aby + by) <= heights[bx][bz];
+                    blocks[bx][by][bz] = is_terrain ? BlockType_Terrain : BlockType_Air;
+                }
+        return;
+    }
+
+    LT_Assert(mode == TerrainMode_Density);
+
+    // The density of a block is its depth below the heightmap plus the 3D noise scaled by
+    // DENSITY_NOISE_AMPLITUDE, and the block is solid when the density is not negative. Since
+    // the noise is clamped to [-1, 1], blocks that are farther than the amplitude from the
+    // heightmap have the same type as with TerrainMode_Heightmap.
+    i32 min_height = heights[0][0];
+    i32 max_height = heights[0][0];
+    for (i32 bx = 0; bx < N; bx++)
+        for (i32 bz = 0; bz < N; bz++)
+        {
+            min_height = std::min(min_height, heights[bx][bz]);
+            max_height = std::max(max_height, heights[bx][bz]);
+        }
+
+    // Most chunks are entirely above or below the band around the surface, so they do not need
+    // any 3D noise at all.
+    if (base_aby > max_height + DENSITY_NOISE_AMPLITUDE)
+    {
+        std::memset(blocks, BlockType_Air, sizeof(BlockType)*N*N*N);
+        return;
+    }
+    if (base_aby + N - 1 <= min_height - DENSITY_NOISE_AMPLITUDE)
+    {
+        for (i32 bx = 0; bx < N; bx++)
+            for (i32 by = 0; by < N; by++)
+                for (i32 bz = 0; bz < N; bz++)
+                    blocks[bx][by][bz] = BlockType_Terrain;
+        return;
+    }
+
+    // PERFORMANCE: The 3D noise is evaluated on a lattice and interpolated for the blocks in
+    // between, and only at the lattice points next to blocks inside of the band. The lattice
+    // points on the faces of the chunk are the same as the ones of its neighbors, so the caves
+    // continue across chunks.
+    constexpr i32 SXZ = DENSITY_LATTICE_SPACING_XZ;
+    constexpr i32 SY = DENSITY_LATTICE_SPACING_Y;
+    constexpr i32 LXZ = N/SXZ + 1;
+    constexpr i32 LY = N/SY + 1;
+    static_assert(N % SXZ == 0 && N % SY == 0, "The lattice spacing should divide the chunk size.");
+
+    bool is_needed[LXZ][LY][LXZ] = {};
+    for (i32 ci = 0; ci < LXZ-1; ci++)
+        for (i32 ck = 0; ck < LXZ-1; ck++)
+        {
+            i32 cell_min_height = heights[ci*SXZ][ck*SXZ];
+            i32 cell_max_height = heights[ci*SXZ][ck*SXZ];
+            for (i32 bx = ci*SXZ; bx < (ci+1)*SXZ; bx++)
+                for (i32 bz = ck*SXZ; bz < (ck+1)*SXZ; bz++)
+                {
+                    cell_min_height = std::min(cell_min_height, heights[bx][bz]);
+                    cell_max_height = std::max(cell_max_height, heights[bx][bz]);
+                }
+
+            const i32 band_start = std::max(cell_min_height - DENSITY_NOISE_AMPLITUDE + 1 - base_aby, 0);
+            const i32 band_end = std::min(cell_max_height + DENSITY_NOISE_AMPLITUDE - base_aby, N-1);
+            for (i32 cj = band_start/SY; cj <= band_end/SY && band_start <= band_end; cj++)
+                for (i32 i = ci; i <= ci+1; i++)
+                    for (i32 j = cj; j <= cj+1; j++)
+                        for (i32 k = ck; k <= ck+1; k++)
+                            is_needed[i][j][k] = true;
+        }
+
+    f64 lattice[LXZ][LY][LXZ];
+    for (i32 i = 0; i < LXZ; i++)
+        for (i32 j = 0; j < LY; j++)
+            for (i32 k = 0; k < LXZ; k++)
+            {
+                if (!is_needed[i][j][k])
+                    continue;
+
+                const f64 x = (f64)chunk_origin.x + Chunk::BLOCK_SIZE*SXZ*i;
+                const f64 y = (f64)(base_aby + SY*j)*Chunk::BLOCK_SIZE;
+                const f64 z = (f64)chunk_origin.z + Chunk::BLOCK_SIZE*SXZ*k;
+                const f64 noise = open_simplex_noise3(m_simplex_ctx, DENSITY_NOISE_FREQUENCY*x,
+                                                      DENSITY_NOISE_FREQUENCY*y, DENSITY_NOISE_FREQUENCY*z);
+                lattice[i][j][k] = std::max(-1.0, std::min(1.0, noise));
+            }
+
+    for (i32 bx = 0; bx < N; bx++)
+        for (i32 bz = 0; bz < N; bz++)
+        {
+            const i32 height = heights[bx][bz];
+            // Blocks of the column that are inside of the band, from band_start until band_end.
+            const i32 band_start = std::min(std::max(height - DENSITY_NOISE_AMPLITUDE + 1 - base_aby, 0), N);
+            const i32 band_end = std::min(std::max(height + DENSITY_NOISE_AMPLITUDE + 1 - base_aby, 0), N);
+
+            for (i32 by = 0; by < band_start; by++)
+                blocks[bx][by][bz] = BlockType_Terrain;
+            for (i32 by = band_end; by < N; by++)
+                blocks[bx][by][bz] = BlockType_Air;
+
+            if (band_start == band_end)
+                continue;
+
+            // Interpolate the noise along x and z once for every lattice layer, so each block
+            // only interpolates along y.
+            const i32 i = bx / SXZ;
+            const i32 k = bz / SXZ;
+            const f64 tx = (f64)(bx % SXZ) / SXZ;
+            const f64 tz = (f64)(bz % SXZ) / SXZ;
+
+            f64 layers[LY];
+            for (i32 j = band_start/SY; j <= (band_end-1)/SY + 1; j++)
+            {
+                const f64 z0 = lattice[i][j][k] + (lattice[i+1][j][k] - lattice[i][j][k])*tx;
+                const f64 z1 = lattice[i][j][k+1] + (lattice[i+1][j][k+1] - lattice[i][j][k+1])*tx;
+                layers[j] = z0 + (z1 - z0)*tz;
+            }
+
+            for (i32 by = band_start; by < band_end; by++)
+            {
+                const i32 j = by / SY;
+                const f64 ty = (f64)(by % SY) / SY;
+                const f64 noise = layers[j] + (layers[j+1] - layers[j])*ty;
+
+                const f64 density = (height - (base_aby + by)) + DENSITY_NOISE_AMPLITUDE*noise;
+                blocks[bx][by][bz] = (density >= 0.0) ? BlockType_Terrain : BlockType_Air;
+            }
+        }
+}
+
+void
+Landscape::debug_benchmark_generation()
+{
+    using clock = std::chrono::high_resolution_clock;
+    lt_local_persist const char *MODE_NAMES[TerrainMode_Count] = {"heightmap", "density"};
+
+    auto generated = std::make_unique<GeneratedBlocks>();
+    f64 generation_ms[TerrainMode_Count] = {};
+    i64 num_solid_blocks[TerrainMode_Count] = {};
+
+    i32 num_chunks = 0;
+
+    // NOTE: Only the main thread moves the center column, so it can be read without the lock.
+    // The chunks of the columns in view are generated again, without touching the loaded chunks.
+    for (i32 mode = 0; mode < TerrainMode_Count; mode++)
+    {
+        // NOTE: The heights are computed again for every mode, since computing them is part of
+        // the generation.
+        invalidate_column_heightmaps();
+        num_chunks = 0;
+
+        const auto start = clock::now();
+        for (i32 column_x = m_center_column_x - m_view_distance; column_x <= m_center_column_x + m_view_distance; column_x++)
+            for (i32 column_z = m_center_column_z - m_view_distance; column_z <= m_center_column_z + m_view_distance; column_z++)
+            {
+                if (!is_column_in_view(column_x, column_z))
+                    continue;
+
+                for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
+                {
+                    const Vec3f chunk_origin = Vec3f(column_x, cy, column_z) * (f32)Chunk::SIZE;
+                    do_chunk_generation_work(chunk_origin, static_cast<TerrainMode>(mode), generated->blocks);
+                    num_chunks++;
+
+                    for (i32 bx = 0; bx < Chunk::NUM_BLOCKS_PER_AXIS; bx++)
+                        for (i32 by = 0; by < Chunk::NUM_BLOCKS_PER_AXIS; by++)
+                            for (i32 bz = 0; bz < Chunk::NUM_BLOCKS_PER_AXIS; bz++)
+                                num_solid_blocks[mode] += generated->blocks[bx][by][bz] != BlockType_Air;
+                }
+            }
+        generation_ms[mode] = std::chrono::duration<f64, std::milli>(clock::now() - start).count();
+    }
+
+    logger.log("Generation benchmark for seed ", m_seed, " (", num_chunks, " chunks):");
+    for (i32 mode = 0; mode < TerrainMode_Count; mode++)
+    {
+        logger.log("    ", MODE_NAMES[mode], ": ", generation_ms[mode], " ms (",
+                   generation_ms[mode] / std::max(generation_ms[TerrainMode_Heightmap], 0.001),
+                   "x heightmap), ", num_solid_blocks[mode], " solid blocks");
+    }
+}
+
+void
+Landscape::finish_chunk_generation(Chunk *chunk, RequestHandle request, const GeneratedBlocks &generated)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(chunk->mutex);
+        // NOTE: The request is checked while holding the lock, since the main thread can cancel
+        // it at any moment.
+        if (!m_request_pool.is_current(request))
+            return;
+
+        chunk->blocks.assign(generated.blocks);
+        chunk->edits = generated.edits;
+        chunk->rebuild_occupancy();
+        chunk->is_generated = true;
+    }
+
+    // The neighbors were meshed as if this chunk was empty, so the faces they share with it have
+    // to be culled.
+    queue_chunk_and_neighbors_meshing(chunk);
+}
+
+void
+Landscape::load_column(i32 column_x, i32 column_z, Vec3f eye)
+{
+    // NOTE: The evicted chunks of the column are looked for once for the whole column.
+    Chunk *evicted[NUM_CHUNKS_Y] = {};
+    for (auto &slot : m_evicted_chunks)
+    {
+        if (slot.chunk && slot.chunk->cx == column_x && slot.chunk->cz == column_z)
+        {
+            evicted[slot.chunk->cy] = slot.chunk;
+            slot.chunk = nullptr;
+        }
+    }
+
+    for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
+    {
+        LT_Assert(!find_chunk(column_x, cy, column_z));
+
+        // PERFORMANCE: The blocks of a chunk taken back did not change, so it is meshed like the
+        // chunks that come back into view, usually from the mesh cache.
+        Chunk *chunk = evicted[cy];
+        if (!chunk)
+        {
+            chunk = memory::allocate_and_construct<Chunk>(m_chunks_allocator, column_x, cy, column_z,
+                                                          &vao_array, &m_request_pool);
+            LT_Assert(chunk);
+        }
+
+        // NOTE: The blocks are generated by the worker threads once the chunk is in view, and
+        // they mesh the chunk and its neighbors when they are done.
+        chunk->lod = get_chunk_lod(chunk, eye);
+        m_chunk_map.insert(chunk);
+    }
+}
+
+void
+Landscape::unload_column(i32 column_x, i32 column_z)
+{
+    for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
+    {
+        Chunk *chunk = find_chunk(column_x, cy, column_z);
+        LT_Assert(chunk && !chunk->is_in_view);
+
+        // NOTE: The workers only touch the chunk of a current request while holding the chunks
+        // mutex, so once the request is cancelled nothing else points to the chunk.
+        chunk->cancel_request();
+        if (chunk->is_request_deferred)
+        {
+            std::lock_guard<std::mutex> lock(m_deferred_chunks_mutex);
+            auto it = std::find(m_deferred_chunks.begin(), m_deferred_chunks.end(), chunk);
+            LT_Assert(it != m_deferred_chunks.end());
+            *it = m_deferred_chunks.back();
+            m_deferred_chunks.pop_back();
+            chunk->is_request_deferred = false;
+        }
+
+        // NOTE: The edits are saved even if the chunk is kept, so they are not lost if the program
+        // stops, and the evicted chunks are destroyed without saving them.
+        save_chunk_if_dirty(chunk);
+
+        m_chunk_map.remove(chunk);
+        evict_chunk(chunk);
+    }
+}
+
+void
+Landscape::evict_chunk(Chunk *chunk)
+{
+    // NOTE: A chunk that was not generated has nothing worth keeping.
+    if (!chunk->is_generated)
+    {
+        destroy_chunk(chunk);
+        return;
+    }
+
+    EvictedChunkSlot *oldest_slot = &m_evicted_chunks[0];
+    for (auto &slot : m_evicted_chunks)
+    {
+        if (!slot.chunk)
+        {
+            oldest_slot = &slot;
+            break;
+        }
+        if (slot.eviction < oldest_slot->eviction)
+            oldest_slot = &slot;
+    }
+
+    if (oldest_slot->chunk)
+        destroy_chunk(oldest_slot->chunk);
+
+    oldest_slot->chunk = chunk;
+    oldest_slot->eviction = ++m_num_evictions;
+}
+
+bool
+Landscape::is_column_within(i32 column_x, i32 column_z, i32 distance) const
+{
+    const i32 dx = column_x - m_center_column_x;
+    const i32 dz = column_z - m_center_column_z;
+    return dx*dx + dz*dz <= distance*distance;
+}
+
+bool
+Landscape::is_column_in_view(i32 column_x, i32 column_z) const
+{
+    return is_column_within(column_x, column_z, m_view_distance);
+}
+
+void
+Landscape::refresh_chunks_in_view(Vec3f eye)
+{
+    // NOTE: The center column moves one chunk at a time and the view distance changes one chunk at
+    // a time, so every loaded column is within one chunk of the unload distance, and the columns
+    // that change are all in this square.
+    constexpr i32 MAX_SCAN_DISTANCE = MAX_VIEW_DISTANCE + UNLOAD_MARGIN + 1;
+    constexpr i32 SCAN_SIZE = 2*MAX_SCAN_DISTANCE + 1;
+    const i32 scan_distance = m_view_distance + UNLOAD_MARGIN + 1;
+
+    lt_local_persist bool needs_meshing[SCAN_SIZE][NUM_CHUNKS_Y][SCAN_SIZE];
+    std::memset(needs_meshing, 0, sizeof(needs_meshing));
+
+    lt_local_persist const i32 HORIZONTAL_OFFSETS[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    // NOTE: Columns are unloaded before loading the others, so the chunk memory never holds more
+    // than the chunks within the unload distance.
+    for (i32 dx = -scan_distance; dx <= scan_distance; dx++)
+        for (i32 dz = -scan_distance; dz <= scan_distance; dz++)
+        {
+            const i32 column_x = m_center_column_x + dx;
+            const i32 column_z = m_center_column_z + dz;
+            if (!is_column_within(column_x, column_z, m_view_distance + UNLOAD_MARGIN) &&
+                find_chunk(column_x, 0, column_z))
+                unload_column(column_x, column_z);
+        }
+
+    for (i32 dx = -scan_distance; dx <= scan_distance; dx++)
+        for (i32 dz = -scan_distance; dz <= scan_distance; dz++)
+        {
+            const i32 column_x = m_center_column_x + dx;
+            const i32 column_z = m_center_column_z + dz;
+            const bool in_view = is_column_in_view(column_x, column_z);
+
+            if (!find_chunk(column_x, 0, column_z))
+            {
+                if (!in_view)
+                    continue;
+                load_column(column_x, column_z, eye);
+            }
+
+            for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
+            {
+                Chunk *chunk = find_chunk(column_x, cy, column_z);
+                if (chunk->is_in_view == in_view)
+                    continue;
+
+                chunk->is_in_view = in_view;
+
+                // NOTE: The level of detail is only kept up to date for the chunks in view.
+                if (in_view)
+                    chunk->lod = get_chunk_lod(chunk, eye);
+
+                if (in_view && !chunk->is_generated)
+                {
+                    // NOTE: The chunk and its neighbors are meshed once the blocks are generated.
+                    chunk->create_request(RequestType_Generate);
+                    const RequestHandle request = chunk->request;
+                    if (!request.is_valid() || !queue_request(QP_High, request))
+                        defer_request(chunk, request);
+                    continue;
+                }
+
+                const i32 sx = dx + MAX_SCAN_DISTANCE;
+                const i32 sz = dz + MAX_SCAN_DISTANCE;
+                if (in_view)
+                {
+                    needs_meshing[sx][cy][sz] = true;
+                }
+                else
+                {
+                    chunk->cancel_request();
+                    release_editable_mesh(chunk);
+                    chunk->release_entry();
+                }
+
+                // The neighbors along x and z now see the chunk appear or disappear.
+                for (const auto &offset : HORIZONTAL_OFFSETS)
+                {
+                    const i32 nx = sx + offset[0];
+                    const i32 nz = sz + offset[1];
+                    if (nx >= 0 && nx < SCAN_SIZE && nz >= 0 && nz < SCAN_SIZE)
+                        needs_meshing[nx][cy][nz] = true;
+                }
+            }
+        }
+
+    // NOTE: Chunks are only queued once, even if several of their neighbors changed.
+    for (i32 dx = -scan_distance; dx <= scan_distance; dx++)
+        for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
+            for (i32 dz = -scan_distance; dz <= scan_distance; dz++)
+            {
+                if (!needs_meshing[dx + MAX_SCAN_DISTANCE][cy][dz + MAX_SCAN_DISTANCE])
+                    continue;
+
+                Chunk *chunk = find_chunk_in_view(m_center_column_x + dx, cy, m_center_column_z + dz);
+                if (chunk && chunk->is_generated)
+                    queue_chunk_meshing(chunk);
+            }
+}
+
+void
+Landscape::set_view_distance(i32 view_distance)
+{
+    m_auto_view_distance = false;
+    m_target_view_distance = std::min(std::max(view_distance, MIN_VIEW_DISTANCE), MAX_VIEW_DISTANCE);
+}
+
+void
+Landscape::set_auto_view_distance(bool enabled)
+{
+    m_auto_view_distance = enabled;
+    m_frames_since_view_change = 0;
+}
+
+void
+Landscape::report_frame_time(f32 frame_time_ms)
+{
+    // Frames around a boundary crossing take longer, so single frames are not trusted.
+    const i32 NUM_FRAMES_BETWEEN_CHANGES = 120;
+    const f32 AVERAGE_WEIGHT = 0.05f;
+    // Number of requests waiting for the workers that is considered a backlog.
+    const i32 MAX_BACKLOG = 2*DEFAULT_VIEW_DISTANCE*NUM_CHUNKS_Y;
+
+    m_average_frame_time_ms += AVERAGE_WEIGHT * (frame_time_ms - m_average_frame_time_ms);
+    m_frames_since_view_change++;
+
+    // NOTE: The landscape is still growing or shrinking, so the frame time is not stable yet.
+    if (!m_auto_view_distance || m_view_distance != m_target_view_distance ||
+        m_frames_since_view_change < NUM_FRAMES_BETWEEN_CHANGES)
+        return;
+
+    i32 backlog = 0;
+    for (const auto &queue : m_chunks_to_process_queues)
+        backlog += ChunkQueue::MAX_ENTRIES - queue.num_free_entries();
+
+    const bool is_slow = m_average_frame_time_ms > 1.1f*FRAME_TIME_BUDGET_MS || backlog > MAX_BACKLOG;
+    const bool is_fast = m_average_frame_time_ms < 0.75f*FRAME_TIME_BUDGET_MS && backlog == 0;
+
+    if (is_slow && m_target_view_distance > MIN_VIEW_DISTANCE)
+        m_target_view_distance--;
+    else if (is_fast && m_target_view_distance < MAX_VIEW_DISTANCE)
+        m_target_view_distance++;
+    else
+        return;
+
+    logger.log("View distance changing to ", m_target_view_distance, " chunks (frame time ",
+               m_average_frame_time_ms, " ms, backlog ", backlog, ")");
+    m_frames_since_view_change = 0;
+}
+
+void
+Landscape::queue_chunk_and_neighbors_meshing(Chunk *chunk)
+{
+    queue_chunk_meshing(chunk);
+
+    lt_local_persist const i32 OFFSETS[6][3] = {
+        {-1, 0, 0}, { 1, 0, 0},
+        { 0, 1, 0}, { 0,-1, 0},
+        { 0, 0, 1}, { 0, 0,-1},
+    };
+
+    for (i32 i = 0; i < 6; i++)
+    {
+        Chunk *neighbor = find_chunk(chunk->cx + OFFSETS[i][0], chunk->cy + OFFSETS[i][1],
+                                     chunk->cz + OFFSETS[i][2]);
+        if (!neighbor || !neighbor->is_generated)
+            continue;
+
+        queue_chunk_meshing(neighbor);
+    }
+}
+
+void
+Landscape::load_or_generate_chunk(Vec3f chunk_origin, GeneratedBlocks &generated)
+{
+    const i32 column_x = static_cast<i32>(std::floor(chunk_origin.x / Chunk::SIZE));
+    const i32 cy = static_cast<i32>(std::floor(chunk_origin.y / Chunk::SIZE));
+    const i32 column_z = static_cast<i32>(std::floor(chunk_origin.z / Chunk::SIZE));
+
+    do_chunk_generation_work(chunk_origin, m_terrain_mode, generated.blocks);
+
+    if (m_region_store.load_chunk(column_x, cy, column_z, generated.blocks, generated.edits))
+        generated.edits.apply(generated.blocks);
+    else
+        generated.edits.clear();
+}
+
+void
+Landscape::save_chunk_if_dirty(Chunk *chunk)
+{
+    if (!chunk->is_generated || !chunk->is_dirty)
+        return;
+
+    m_region_store.save_chunk(chunk->cx, chunk->cy, chunk->cz, chunk->edits);
+    chunk->is_dirty = false;
+}
+
+bool
+Landscape::is_mesh_empty(const Chunk *chunk) const
+{
+    constexpr i32 N = Chunk::NUM_BLOCKS_PER_AXIS;
+
+    const i32 cx = chunk->cx;
+    const i32 cy = chunk->cy;
+    const i32 cz = chunk->cz;
+
+    // NOTE: The outside of the world, the chunks that are not loaded and the ones out of view are
+    // air for the meshers, so the chunks next to them are always exposed.
+    const Chunk *left = find_chunk_in_view(cx-1, cy, cz);
+    const Chunk *right = find_chunk_in_view(cx+1, cy, cz);
+    const Chunk *bottom = find_chunk_in_view(cx, cy-1, cz);
+    const Chunk *top = find_chunk_in_view(cx, cy+1, cz);
+    const Chunk *back = find_chunk_in_view(cx, cy, cz-1);
+    const Chunk *front = find_chunk_in_view(cx, cy, cz+1);
+    const bool is_exposed = !left || !right || !bottom || !top || !back || !front;
+
+    ChunkReadLocks locks;
+    locks.add(chunk);
+    if (!is_exposed)
+    {
+        locks.add(left);
+        locks.add(right);
+        locks.add(bottom);
+        locks.add(top);
+        locks.add(back);
+        locks.add(front);
+    }
+    locks.lock();
+
+    if (!chunk->blocks.is_uniform())
+        return false;
+    if (chunk->blocks.get(0, 0, 0) == BlockType_Air)
+        return true;
+
+    // A solid chunk only has visible faces where a neighbor does not cover it completely.
+    if (is_exposed)
+        return false;
+
+    for (i32 i = 0; i < N; i++)
+        for (i32 j = 0; j < N; j++)
+        {
+            // The rows of the neighbors only need the bit of the block that touches this chunk.
+            if (!((left->occupancy_x[i][j] >> (N-1)) & 1) || !(right->occupancy_x[i][j] & 1))
+                return false;
+            if (!((bottom->occupancy_y[i][j] >> (N-1)) & 1) || !(top->occupancy_y[i][j] & 1))
+                return false;
+            if (!((back->occupancy_z[i][j] >> (N-1)) & 1) || !(front->occupancy_z[i][j] & 1))
+                return false;
+        }
+
+    return true;
+}
+
+void
+Landscape::queue_chunk_meshing(Chunk *chunk)
+{
+    // PERFORMANCE: Chunks whose mesh is known to be empty are not meshed at all. When the chunk
+    // still has a mesh from before, the request is queued anyway so the mesh is removed in order
+    // with the other requests of the chunk.
+    const bool skip_meshing = !chunk->is_in_view || (chunk->entry_index < 0 && is_mesh_empty(chunk));
+
+    RequestHandle request;
+    {
+        std::unique_lock<std::shared_mutex> lock(chunk->mutex);
+        if (skip_meshing)
+        {
+            chunk->cancel_request();
+            return;
+        }
+
+        chunk->create_request();
+        request = chunk->request;
+    }
+
+    if (!request.is_valid() || !queue_request(QP_Low, request))
+        defer_request(chunk, request);
 }
 
-lt_internal f64
-get_fbm(struct osn_context *ctx, f64 x, f64 y, f64 amplitude,
-        f64 frequency, i32 num_octaves, f64 lacunarity, f64 gain)
+void
+Landscape::defer_request(Chunk *chunk, RequestHandle rejected)
 {
-    f64 fbm = 0.0;
-    for (i32 i = 0; i < num_octaves; i++)
     {
-        fbm += amplitude * open_simplex_noise2(ctx, frequency*x, frequency*y);
-        amplitude *= gain;
-        frequency *= lacunarity;
+        std::unique_lock<std::shared_mutex> lock(chunk->mutex);
+        chunk->cancel_request();
+    }
+    if (rejected.is_valid())
+        m_request_pool.give_back(rejected);
+
+    // NOTE: A chunk whose request is deferred again before the main thread retried it is already
+    // in the list.
+    if (!chunk->is_request_deferred.exchange(true))
+    {
+        std::lock_guard<std::mutex> lock(m_deferred_chunks_mutex);
+        m_deferred_chunks.push_back(chunk);
     }
-    return fbm;
 }
 
-struct ChunkNoise
+void
+Landscape::retry_deferred_requests()
 {
-    f64 map[Landscape::Chunk::NUM_BLOCKS_PER_AXIS][Landscape::Chunk::NUM_BLOCKS_PER_AXIS];
-};
+    // NOTE: The list is taken as a whole, so the chunks deferred again while it is looked at
+    // are only retried on the next frame.
+    {
+        std::lock_guard<std::mutex> lock(m_deferred_chunks_mutex);
+        if (m_deferred_chunks.empty())
+            return;
+        m_retried_chunks.swap(m_deferred_chunks);
+    }
 
-ChunkNoise *
-Landscape::fill_noise_map_for_chunk_column(f32 origin_x, f32 origin_z)
-{
-    //
-    // PERFORMANCE: remove heap allocated buffer for better performance.
-    //
-    auto chunk_noise = new ChunkNoise();
-    LT_Assert(chunk_noise);
+    for (usize i = 0; i < m_retried_chunks.size(); i++)
+    {
+        Chunk *chunk = m_retried_chunks[i];
 
-    // Fill out noise_map
-    for (i32 z = 0; z < Chunk::NUM_BLOCKS_PER_AXIS; z++)
-        for (i32 x = 0; x < Chunk::NUM_BLOCKS_PER_AXIS; x++)
+        // NOTE: Meshes are also deferred when the main thread did not upload the previous
+        // ones yet, so the processed queue needs room as well.
+        const QueuePriority priority = chunk->is_generated ? QP_Low : QP_High;
+        if (m_chunks_to_process_queues[priority].num_free_entries() == 0 ||
+            m_chunks_processed_queues[QP_Low].num_free_entries() == 0)
         {
-            const f64 noise_x = (f64)origin_x + Chunk::BLOCK_SIZE*x;
-            const f64 noise_y = (f64)origin_z + Chunk::BLOCK_SIZE*z;
-            const f64 noise = get_fbm(m_simplex_ctx, noise_x, noise_y, m_amplitude,
-                                      m_frequency, m_num_octaves, m_lacunarity, m_gain);
-            chunk_noise->map[z][x] = noise;
+            // The chunks that were not retried keep their flag and go back to the list.
+            std::lock_guard<std::mutex> lock(m_deferred_chunks_mutex);
+            m_deferred_chunks.insert(m_deferred_chunks.end(), m_retried_chunks.begin() + i, m_retried_chunks.end());
+            break;
         }
 
-    // Rescale noise values into 0 -> 1 range
-    const f64 min = -1.0;
-    const f64 max = 1.0;
+        chunk->is_request_deferred = false;
+        // NOTE: Chunks out of view get their request when they come back into view.
+        if (!chunk->is_in_view)
+            continue;
 
-    // // - Actually rescale the values
-    for (i32 z = 0; z < Chunk::NUM_BLOCKS_PER_AXIS; z++)
-        for (i32 x = 0; x < Chunk::NUM_BLOCKS_PER_AXIS; x++)
+        if (chunk->is_generated)
         {
-            chunk_noise->map[z][x] = (chunk_noise->map[z][x] + (max - min)) / (2*max - min);
-
-#define EPSILON 0.001
-            LT_Assert(chunk_noise->map[z][x] <= (max+EPSILON) && chunk_noise->map[z][x] >= (min-EPSILON));
-
-            LT_Assert(chunk_noise->map[z][x] <= (1.0 + EPSILON) && chunk_noise->map[z][x] >= -EPSILON);
-#undef EPSILON
+            queue_chunk_meshing(chunk);
         }
-
-    return chunk_noise;
+        else
+        {
+            RequestHandle request;
+            {
+                std::unique_lock<std::shared_mutex> lock(chunk->mutex);
+                chunk->create_request(RequestType_Generate);
+                request = chunk->request;
+            }
+            if (!request.is_valid() || !queue_request(priority, request))
+                defer_request(chunk, request);
+        }
+    }
+    m_retried_chunks.clear();
 }
 
 void
-Landscape::pass_chunk_buffer_to_gpu(const VAOArray::Entry &entry, const std::vector<Vertex_PLN> &buf)
+Landscape::run_request_job(void *data)
 {
-    glBindVertexArray(entry.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, entry.vbo);
-    // TODO: Figure out if GL_DYNAMIC_DRAW is the best enum to use or there's something better.
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex_PLN) * entry.num_vertices_used, &buf[0], GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_PLN),
-                          (const void*)offsetof(Vertex_PLN, position));
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_PLN),
-                          (const void*)offsetof(Vertex_PLN, tex_coords_layer));
-    glEnableVertexAttribArray(1);
-
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex_PLN),
-                          (const void*)offsetof(Vertex_PLN, normal));
-    glEnableVertexAttribArray(2);
+    Landscape *landscape = static_cast<Landscape*>(data);
+    if (landscape->m_jobs_should_run)
+        landscape->process_next_request();
+    landscape->m_num_pending_jobs--;
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, entry.num_vertices_used);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+bool
+Landscape::queue_request(QueuePriority priority, RequestHandle request)
+{
+    if (!m_chunks_to_process_queues[priority].insert(request))
+        return false;
+
+    // NOTE: Every job processes one request, but not necessarily the one it was queued with,
+    // since generating chunks goes before meshing them.
+    m_num_pending_jobs++;
+    m_job_system->submit(Job{&Landscape::run_request_job, this},
+                         (priority == QP_High) ? JobPriority_High : JobPriority_Low);
+    return true;
 }
 
 void
-Landscape::generate()
+Landscape::process_next_request()
 {
-    logger.log("Generating landscape");
+    // Snapshot of the chunk being meshed, reused between requests of the same worker.
+    lt_local_persist thread_local std::unique_ptr<PaddedChunk> padded;
+    lt_local_persist thread_local std::unique_ptr<GeneratedBlocks> generated;
+    if (!padded)
+    {
+        padded = std::make_unique<PaddedChunk>();
+        generated = std::make_unique<GeneratedBlocks>();
+    }
+
+    // NOTE: The main thread only uploads a few meshes per frame. When it falls behind and the queue
+    // is full, the mesh is thrown away and the chunk is meshed again once there is room, so the
+    // worker never waits for the main thread.
+    auto pass_processed_request = [this](i32 priority, RequestHandle handle) {
+        if (m_chunks_processed_queues[priority].insert(handle))
+            return;
+
+        QueueRequest *request = &m_request_pool[handle];
+        chunks_mutex.lock_low_priority(); // LOCK
+        if (m_request_pool.is_current(handle))
+            defer_request(request->chunk, handle);
+        else
+            m_request_pool.give_back(handle);
+        chunks_mutex.unlock_low_priority(); // UNLOCK
+    };
 
-    for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
-        for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
+    for (i32 i = 0; i < QP_Count; i++)
+    {
+        auto &queue = m_chunks_to_process_queues[i];
+        const RequestHandle handle = queue.take_next_request();
+        if (!handle.is_valid())
+            continue;
+
+        // PERFORMANCE: Requests cancelled while they were queued are dropped right away,
+        // without looking at their chunk.
+        if (!m_request_pool.is_current(handle))
         {
-            chunks_mutex.lock_high_priority(); // LOCK
+            m_request_pool.give_back(handle);
+            break;
+        }
 
-            Chunk *chunk = chunk_ptrs[cx][0][cz].get();
-            LT_Assert(chunk);
-            ChunkNoise *chunk_noise = fill_noise_map_for_chunk_column(chunk->origin.x, chunk->origin.z);
+        QueueRequest *request = &m_request_pool[handle];
+        if (request->type == RequestType_Generate)
+        {
+            // NOTE: The blocks are generated without holding the lock, since the chunk may be
+            // removed from the landscape in the meantime. They are only copied into the chunk
+            // if the request is still the latest one of the chunk.
+            load_or_generate_chunk(request->chunk_origin, *generated);
 
-            for (i32 bx = 0; bx < Chunk::NUM_BLOCKS_PER_AXIS; bx++)
-                for (i32 bz = 0; bz < Chunk::NUM_BLOCKS_PER_AXIS; bz++)
-                {
-                    const f64 normalized_height = chunk_noise->map[bz][bx];
-                    const i32 abs_block_y = std::round((f64)(TOTAL_BLOCKS_Y-1) * normalized_height);
+            chunks_mutex.lock_low_priority(); // LOCK
 
-                    for (i32 aby = 0; aby <= abs_block_y; aby++)
-                    {
-                        const i32 cy = aby / Chunk::NUM_BLOCKS_PER_AXIS;
-                        const i32 by = aby % Chunk::NUM_BLOCKS_PER_AXIS;
+            // NOTE: A chunk cancels its request before leaving the landscape, which needs the
+            // chunks mutex, so the chunk of a current request is alive until the mutex is unlocked.
+            if (m_request_pool.is_current(handle))
+                finish_chunk_generation(request->chunk, handle, *generated);
 
-                        chunk_ptrs[cx][cy][cz]->blocks[bx][by][bz] = BlockType_Terrain;
-                    }
-                }
+            chunks_mutex.unlock_low_priority(); // UNLOCK
 
-            chunks_mutex.unlock_high_priority(); // UNLOCK
-            delete[] chunk_noise;
+            m_request_pool.give_back(handle);
+            break;
         }
-
-    for (i32 cx = 0; cx < NUM_CHUNKS_X; cx++)
-        for (i32 cy = 0; cy < NUM_CHUNKS_Y; cy++)
-            for (i32 cz = 0; cz < NUM_CHUNKS_Z; cz++)
+        else
+        {
+            // NOTE: The lock is only held while copying the blocks, the meshing itself
+            // works on the padded copy. The chunks mutex is shared by the workers, so they
+            // copy different chunks at the same time, and only the locks of the chunk and its
+            // neighbors keep the main thread from editing them.
+            chunks_mutex.lock_low_priority(); // LOCK
+
+            // NOTE: A request that was replaced by a newer one for the same chunk would not be
+            // uploaded, so it is treated as cancelled.
+            Chunk *chunk = request->chunk;
+            const bool is_cancelled = !m_request_pool.is_current(handle);
+            const bool is_empty = !is_cancelled && is_mesh_empty(chunk);
+            i32 lod = 0;
+            if (!is_cancelled && !is_empty)
             {
-                chunks_mutex.lock_high_priority(); // LOCK
+                gather_padded_chunk(chunk, padded.get());
+                lod = chunk->lod;
+            }
 
-                Chunk *chunk = chunk_ptrs[cx][cy][cz].get();
-                chunk->create_request();
-                m_chunks_to_process_queues[QP_Low].insert(chunk->request, &m_chunks_to_process_semaphore);
+            chunks_mutex.unlock_low_priority(); // UNLOCK
 
-                chunks_mutex.unlock_high_priority(); // UNLOCK
+            if (is_empty)
+            {
+                // NOTE: Nothing to mesh, the request only removes the previous mesh of the chunk.
+                LT_Assert(request->vertexes.empty());
+                std::fill(request->face_num_quads, request->face_num_quads + BlockFace_Count, 0);
+                request->processed = true;
+                pass_processed_request(i, handle);
             }
-}
+            else if (!is_cancelled)
+            {
+                ChunkVertexBuffer vertices = m_vertex_buffer_pool.take();
 
-void
-Landscape::do_chunk_generation_work(Chunk *chunk)
-{
-    const i32 cy = static_cast<i32>(chunk->origin.y - origin.y) / Chunk::SIZE;
-    ChunkNoise *chunk_noise = fill_noise_map_for_chunk_column(chunk->origin.x, chunk->origin.z);
-    LT_Assert(chunk_noise);
+                downsample_padded_chunk(*padded, lod, m_lod_downsampling);
 
-    for (i32 bx = 0; bx < Chunk::NUM_BLOCKS_PER_AXIS; bx++)
-        for (i32 bz = 0; bz < Chunk::NUM_BLOCKS_PER_AXIS; bz++)
-        {
-            const f64 normalized_height = chunk_noise->map[bz][bx];
-            const i32 height_aby = std::round((f64)(TOTAL_BLOCKS_Y-1) * normalized_height);
-            const i32 height_by = height_aby % Chunk::NUM_BLOCKS_PER_AXIS;
-            const i32 height_cy = height_aby / Chunk::NUM_BLOCKS_PER_AXIS;
+                // Chunks that look the same as a chunk meshed before reuse its mesh.
+                const MeshingMode mode = m_meshing_mode;
+                const PaddedChunkHash hash = hash_padded_chunk(*padded);
+                if (!m_mesh_cache.find(hash, *padded, mode, vertices))
+                {
+                    update_chunk_buffer(*padded, mode, vertices);
+                    m_mesh_cache.insert(hash, *padded, mode, vertices);
+                }
 
-            if (height_cy > cy)
-            {
-                for (i32 by = 0; by < Chunk::NUM_BLOCKS_PER_AXIS; by++)
-                    chunk->blocks[bx][by][bz] = BlockType_Terrain;
+                m_num_chunks_meshed++;
+
+                count_face_quads(vertices, request->face_num_quads);
+                request->vertexes = std::move(vertices);
+                request->processed = true;
+                pass_processed_request(i, handle);
             }
-            else if (height_cy == cy)
+            else
             {
-                for (i32 by = 0; by <= height_by; by++)
-                    chunk->blocks[bx][by][bz] = BlockType_Terrain;
+                m_request_pool.give_back(handle);
             }
+            break;
         }
+    }
+}
 
-    delete[] chunk_noise;
+void
+Landscape::stop_jobs()
+{
+    logger.log("Stopping jobs...");
+    // NOTE: The jobs that are still queued return right away, but they point to the landscape,
+    // so it has to wait for all of them to run.
+    m_jobs_should_run = false;
+    while (m_num_pending_jobs > 0)
+        std::this_thread::yield();
 }
 
 void
-Landscape::run_worker_thread()
+Landscape::destroy_chunk(Chunk *chunk)
 {
-    logger.log("Thread ", std::this_thread::get_id(), " started");
-    while (m_threads_should_run)
-    {
-        for (i32 i = 0; i < QP_Count; i++)
-        {
-            auto &queue = m_chunks_to_process_queues[i];
-            auto request = queue.take_next_request();
+    release_editable_mesh(chunk);
+    memory::destroy_and_deallocate(m_chunks_allocator, chunk);
+}
 
-            if (request) // there is a request to process.
-            {
-                chunks_mutex.lock_low_priority(); // LOCK
 
-                if (request->chunk)
-                {
-                    request->vertexes = update_chunk_buffer(request->chunk);
-                    request->processed = true;
-                    m_chunks_processed_queues[i].insert(request, nullptr);
-                }
-                else
-                {
-                    // NOTE: If chunk is null, it means the request was cancelled, so it should be ignored.
-                }
+// ----------------------------------------------------------------------------------------------
+// Chunk Map
+// ----------------------------------------------------------------------------------------------
 
-                chunks_mutex.unlock_low_priority(); // UNLOCK
-                break;
-            }
-        }
+Landscape::ChunkMap::ChunkMap()
+    : m_num_chunks(0)
+{
+    static_assert(NUM_SLOTS >= 2*MAX_CHUNKS, "The chunk map should have twice as many slots as chunks.");
+    static_assert(NUM_CHUNKS_Y <= 256, "The height of the chunks does not fit in their key.");
 
-        // Wait for more work to be added to the queue.
-        m_chunks_to_process_semaphore.wait();
+    for (auto &slot : m_slots)
+    {
+        slot.key = 0;
+        slot.chunk = nullptr;
+        slot.index = -1;
     }
 }
 
-void
-Landscape::stop_threads()
+u64
+Landscape::ChunkMap::make_key(i32 cx, i32 cy, i32 cz)
+{
+    // NOTE: 28 bits are kept along x and z, so the keys only repeat every 2^28 chunks.
+    return ((u64)(cx & 0xFFFFFFF) << 36) | ((u64)(cz & 0xFFFFFFF) << 8) | (u64)cy;
+}
+
+u32
+Landscape::ChunkMap::home_slot(u64 key)
+{
+    // NOTE: Fibonacci hashing, neighbor chunks have close keys but end up in distant slots.
+    return (u32)((key * 0x9E3779B97F4A7C15ull) >> (64 - NUM_SLOT_BITS));
+}
+
+u32
+Landscape::ChunkMap::find_slot(u64 key) const
+{
+    u32 slot = home_slot(key);
+    // NOTE: There are always empty slots, so the probe ends.
+    while (m_slots[slot].chunk && m_slots[slot].key != key)
+        slot = (slot + 1) & (NUM_SLOTS - 1);
+    return slot;
+}
+
+Landscape::Chunk *
+Landscape::ChunkMap::find(i32 cx, i32 cy, i32 cz) const
 {
-    logger.log("Stopping threads...");
-    // Notify all threads that they should not run anymore.
-    m_threads_should_run = false;
-    m_chunks_to_process_semaphore.notify_all(m_threads.size());
-    for (auto &thread : m_threads) thread.join();
+    if (cy < 0 || cy >= NUM_CHUNKS_Y)
+        return nullptr;
+    return m_slots[find_slot(make_key(cx, cy, cz))].chunk;
 }
 
 void
-Landscape::initialize_threads()
+Landscape::ChunkMap::insert(Chunk *chunk)
 {
-    logger.log("Initializing threads...");
-    m_threads_should_run = true;
-    for (auto &thread : m_threads)
-    {
-        thread = std::thread(std::bind(&Landscape::run_worker_thread, _1), this);
-    }
+    LT_Assert(chunk);
+    LT_Assert(m_num_chunks < MAX_CHUNKS);
+
+    const u64 key = make_key(chunk->cx, chunk->cy, chunk->cz);
+    const u32 slot = find_slot(key);
+    LT_Assert(!m_slots[slot].chunk);
+
+    m_slots[slot].key = key;
+    m_slots[slot].chunk = chunk;
+    m_slots[slot].index = m_num_chunks;
+    m_chunks[m_num_chunks] = chunk;
+    m_chunk_slots[m_num_chunks] = slot;
+    m_num_chunks++;
 }
 
 void
-Landscape::chunk_deleter(Chunk *chunk)
+Landscape::ChunkMap::remove(const Chunk *chunk)
 {
-    memory::destroy_and_deallocate(m_chunks_allocator, chunk);
+    u32 slot = find_slot(make_key(chunk->cx, chunk->cy, chunk->cz));
+    LT_Assert(m_slots[slot].chunk == chunk);
+    const i32 index = m_slots[slot].index;
+
+    // NOTE: The chunks after the removed one are shifted back into its slot when their home slot
+    // allows it, so the probes never stop on a hole left in the middle of a run.
+    for (u32 next = (slot + 1) & (NUM_SLOTS - 1); m_slots[next].chunk; next = (next + 1) & (NUM_SLOTS - 1))
+    {
+        const u32 home = home_slot(m_slots[next].key);
+        if (((next - home) & (NUM_SLOTS - 1)) >= ((next - slot) & (NUM_SLOTS - 1)))
+        {
+            m_slots[slot] = m_slots[next];
+            m_chunk_slots[m_slots[slot].index] = slot;
+            slot = next;
+        }
+    }
+
+    m_slots[slot].key = 0;
+    m_slots[slot].chunk = nullptr;
+    m_slots[slot].index = -1;
+
+    // The last chunk of the packed array takes the place of the removed one.
+    m_num_chunks--;
+    if (index != m_num_chunks)
+    {
+        m_chunks[index] = m_chunks[m_num_chunks];
+        m_chunk_slots[index] = m_chunk_slots[m_num_chunks];
+        m_slots[m_chunk_slots[index]].index = index;
+    }
 }
 
 
@@ -906,36 +2266,114 @@ Landscape::chunk_deleter(Chunk *chunk)
 // Chunk
 // ----------------------------------------------------------------------------------------------
 
-Landscape::Chunk::Chunk(Vec3f origin, VAOArray *va, BlockType fill_type)
-    : origin(origin)
-    , request(nullptr)
+Landscape::Chunk::Chunk(i32 cx, i32 cy, i32 cz, VAOArray *va, RequestPool *request_pool, BlockType fill_type)
+    : cx(cx)
+    , cy(cy)
+    , cz(cz)
+    , origin(Vec3f(cx*SIZE, cy*SIZE, cz*SIZE))
+    , editable_mesh_index(-1)
+    , lod(0)
+    , is_generated(false)
+    , is_request_deferred(false)
+    , is_in_view(false)
+    , is_dirty(false)
     , m_vao_array(va)
+    , m_request_pool(request_pool)
 {
-    entry_index = m_vao_array->take_free_entry();
-
-    for (i32 x = 0; x < NUM_BLOCKS_PER_AXIS; x++)
-        for (i32 y = 0; y < NUM_BLOCKS_PER_AXIS; y++)
-            for (i32 z = 0; z < NUM_BLOCKS_PER_AXIS; z++)
-                blocks[x][y][z] = fill_type;
+    entry_index = -1;
+    blocks.fill(fill_type);
+    rebuild_occupancy();
 }
 
 Landscape::Chunk::~Chunk()
 {
+    release_entry();
+}
+
+Landscape::VAOArray::Entry &
+Landscape::Chunk::take_entry()
+{
+    if (entry_index < 0)
+    {
+        entry_index = m_vao_array->take_free_entry();
+        m_vao_array->vaos[entry_index].origin = origin;
+    }
+    return m_vao_array->vaos[entry_index];
+}
+
+void
+Landscape::Chunk::release_entry()
+{
+    if (entry_index < 0)
+        return;
+
     m_vao_array->free_entry(entry_index);
+    entry_index = -1;
 }
 
 void
-Landscape::Chunk::create_request()
+Landscape::Chunk::create_request(RequestType type)
 {
-    // TODO: maybe remove using the heap for the allocation of this object.
-    request = std::make_shared<QueueRequest>(this);
+    cancel_request();
+    request = m_request_pool->take(this, type, origin);
 }
 
 void
 Landscape::Chunk::cancel_request()
 {
-    if (request && request->chunk)
-        request->chunk = nullptr;
+    if (request.is_valid())
+        m_request_pool->cancel(request);
+    request = RequestHandle();
+}
+
+void
+Landscape::Chunk::set_block(i32 bx, i32 by, i32 bz, BlockType type)
+{
+    LT_Assert(bx >= 0 && bx < NUM_BLOCKS_PER_AXIS);
+    LT_Assert(by >= 0 && by < NUM_BLOCKS_PER_AXIS);
+    LT_Assert(bz >= 0 && bz < NUM_BLOCKS_PER_AXIS);
+
+    blocks.set(bx, by, bz, type);
+
+    if (type != BlockType_Air)
+    {
+        occupancy_x[by][bz] |= (1 << bx);
+        occupancy_y[bx][bz] |= (1 << by);
+        occupancy_z[bx][by] |= (1 << bz);
+    }
+    else
+    {
+        occupancy_x[by][bz] &= ~(1 << bx);
+        occupancy_y[bx][bz] &= ~(1 << by);
+        occupancy_z[bx][by] &= ~(1 << bz);
+    }
+}
+
+void
+Landscape::Chunk::rebuild_occupancy()
+{
+    std::memset(occupancy_x, 0, sizeof(occupancy_x));
+    std::memset(occupancy_y, 0, sizeof(occupancy_y));
+    std::memset(occupancy_z, 0, sizeof(occupancy_z));
+
+    if (blocks.is_uniform() && blocks.get(0, 0, 0) == BlockType_Air)
+        return;
+
+    BlockType row[NUM_BLOCKS_PER_AXIS];
+    for (i32 x = 0; x < NUM_BLOCKS_PER_AXIS; x++)
+        for (i32 y = 0; y < NUM_BLOCKS_PER_AXIS; y++)
+        {
+            blocks.get_row_z(x, y, row);
+            for (i32 z = 0; z < NUM_BLOCKS_PER_AXIS; z++)
+            {
+                if (row[z] == BlockType_Air)
+                    continue;
+
+                occupancy_x[y][z] |= (1 << x);
+                occupancy_y[x][z] |= (1 << y);
+                occupancy_z[x][y] |= (1 << z);
+            }
+        }
 }
 
 // ----------------------------------------------------------------------------------------------
@@ -944,19 +2382,87 @@ Landscape::Chunk::cancel_request()
 Landscape::VAOArray::Entry::Entry()
     : vao(GLResources::instance().create_vertex_array())
     , vbo(GLResources::instance().create_buffer())
-    , num_vertices_used(0)
+    , num_quads(0)
+    , face_num_quads()
+    , is_sorted_by_face(false)
+    , origin(0)
     , is_used(false)
 {}
 
+Landscape::VAOArray::VAOArray()
+    : quad_ebo(GLResources::instance().create_buffer())
+{
+    // Every quad is drawn as the triangles (0, 1, 2) and (2, 3, 0), so one index buffer
+    // big enough for the worst case chunk can be shared by all of the chunks.
+    std::vector<u32> indices(Chunk::MAX_QUADS * 6);
+    for (i32 quad = 0; quad < Chunk::MAX_QUADS; quad++)
+    {
+        const u32 first_vertex = quad * 4;
+        indices[quad*6 + 0] = first_vertex + 0;
+        indices[quad*6 + 1] = first_vertex + 1;
+        indices[quad*6 + 2] = first_vertex + 2;
+        indices[quad*6 + 3] = first_vertex + 2;
+        indices[quad*6 + 4] = first_vertex + 3;
+        indices[quad*6 + 5] = first_vertex + 0;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * indices.size(), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+Landscape::VertexBufferPool::VertexBufferPool()
+{
+    buffers.reserve(MAX_BUFFERS);
+}
+
+ChunkVertexBuffer
+Landscape::VertexBufferPool::take()
+{
+    std::lock_guard<decltype(mutex)> lock(mutex);
+    if (buffers.empty())
+        return ChunkVertexBuffer();
+
+    ChunkVertexBuffer buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void
+Landscape::VertexBufferPool::give_back(ChunkVertexBuffer &buffer)
+{
+    // NOTE: Buffers that never allocated are not worth keeping.
+    if (buffer.capacity() == 0)
+        return;
+
+    buffer.clear();
+
+    {
+        std::lock_guard<decltype(mutex)> lock(mutex);
+        if ((i32)buffers.size() < MAX_BUFFERS)
+        {
+            buffers.push_back(std::move(buffer));
+            buffer = ChunkVertexBuffer();
+            return;
+        }
+    }
+
+    // NOTE: When the pool is full the buffer is freed, this bounds the memory kept around after
+    // a burst of requests. Meshing only needs as many buffers as there are meshes in flight, so
+    // the pool does not run dry once the burst is over.
+    ChunkVertexBuffer().swap(buffer);
+}
+
 isize
 Landscape::VAOArray::take_free_entry()
 {
-    for (isize i = 0; i < NUM_CHUNKS; i++)
+    for (isize i = 0; i < MAX_CHUNKS_IN_VIEW; i++)
     {
         if (!vaos[i].is_used)
         {
             vaos[i].is_used = true;
-            vaos[i].num_vertices_used = 0;
+            vaos[i].num_quads = 0;
+            vaos[i].is_sorted_by_face = false;
             return i;
         }
     }
@@ -967,41 +2473,165 @@ void
 Landscape::VAOArray::free_entry(isize index)
 {
     LT_Assert(index >= 0);
-    LT_Assert(index < NUM_CHUNKS);
+    LT_Assert(index < MAX_CHUNKS_IN_VIEW);
     LT_Assert(vaos[index].is_used);
 
     vaos[index].is_used = false;
 }
 
+Landscape::RequestPool::RequestPool(VertexBufferPool *vertex_buffers)
+    : vertex_buffers(vertex_buffers)
+    , free_head(0)
+{
+    for (i32 i = 0; i < MAX_REQUESTS; i++)
+    {
+        requests[i].chunk = nullptr;
+        requests[i].generation.store(0, std::memory_order_relaxed);
+        requests[i].processed.store(false, std::memory_order_relaxed);
+        requests[i].next_free.store((i < MAX_REQUESTS-1) ? i+1 : RequestHandle::INVALID_INDEX,
+                                    std::memory_order_relaxed);
+    }
+}
+
+Landscape::RequestHandle
+Landscape::RequestPool::take(Chunk *chunk, RequestType type, Vec3f chunk_origin)
+{
+    u64 head = free_head.load(std::memory_order_acquire);
+    u32 index;
+    for (;;)
+    {
+        index = (u32)head;
+        if (index == RequestHandle::INVALID_INDEX)
+            return RequestHandle();
+
+        const u64 next_head = ((head >> 32) + 1) << 32 | requests[index].next_free.load(std::memory_order_relaxed);
+        if (free_head.compare_exchange_weak(head, next_head, std::memory_order_acquire, std::memory_order_acquire))
+            break;
+    }
+
+    QueueRequest &request = requests[index];
+    request.chunk = chunk;
+    request.type = type;
+    request.chunk_origin = chunk_origin;
+    request.processed = false;
+
+    RequestHandle handle;
+    handle.index = index;
+    // NOTE: Handles to the previous uses of the request become stale.
+    handle.generation = request.generation.fetch_add(1, std::memory_order_release) + 1;
+    return handle;
+}
+
 void
-Landscape::ChunkQueue::insert(const std::shared_ptr<QueueRequest> &request, Semaphore *semaphore)
+Landscape::RequestPool::give_back(RequestHandle handle)
 {
-    std::lock_guard<decltype(mutex)> lock(mutex);
+    LT_Assert(handle.is_valid());
+    // NOTE: The vertices go back to the buffer pool, so their capacity is used by the next mesh
+    // instead of staying in the request until it is used again.
+    vertex_buffers->give_back(requests[handle.index].vertexes);
+
+    u64 head = free_head.load(std::memory_order_relaxed);
+    u64 next_head;
+    do
+    {
+        requests[handle.index].next_free.store((u32)head, std::memory_order_relaxed);
+        next_head = ((head >> 32) + 1) << 32 | handle.index;
+    }
+    while (!free_head.compare_exchange_weak(head, next_head, std::memory_order_release, std::memory_order_relaxed));
+}
 
-    const i32 next_write_index = (write_index + 1) % MAX_ENTRIES;
-    // if next write and read index are the same, the queue is full.
-    LT_Assert(next_write_index != read_index);
+void
+Landscape::RequestPool::cancel(RequestHandle handle)
+{
+    LT_Assert(handle.is_valid());
 
-    requests[write_index] = request;
-    write_index = next_write_index;
-    if (semaphore) semaphore->notify();
+    // NOTE: If the generation already changed, the request was cancelled before or it was given back
+    // and taken for another chunk, so it is left alone.
+    u32 generation = handle.generation;
+    requests[handle.index].generation.compare_exchange_strong(generation, generation + 1, std::memory_order_acq_rel);
 }
 
-std::shared_ptr<Landscape::QueueRequest>
-Landscape::ChunkQueue::take_next_request()
+Landscape::ChunkQueue::ChunkQueue()
+    : write_position(0)
+    , read_position(0)
 {
-    std::lock_guard<decltype(mutex)> lock(mutex);
-    if (read_index != write_index) // There is an entry to consume
+    for (i32 i = 0; i < MAX_ENTRIES; i++)
+        entries[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool
+Landscape::ChunkQueue::insert(RequestHandle request)
+{
+    u64 position = write_position.load(std::memory_order_relaxed);
+    Entry *entry;
+    for (;;)
     {
-        const i32 next_read_index = (read_index + 1) % MAX_ENTRIES;
-        std::shared_ptr<QueueRequest> req = requests[read_index];
-        read_index = next_read_index;
-        return req;
+        entry = &entries[position % MAX_ENTRIES];
+        const u64 sequence = entry->sequence.load(std::memory_order_acquire);
+        const i64 difference = (i64)sequence - (i64)position;
+
+        if (difference == 0)
+        {
+            // The entry is free, take it unless another thread took it first.
+            if (write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // The entry still holds the request from the previous lap, so the queue is full.
+            return false;
+        }
+        else
+        {
+            position = write_position.load(std::memory_order_relaxed);
+        }
     }
-    else // There is not an entry to consume, return a null pointer
+
+    entry->request = request;
+    entry->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+i32
+Landscape::ChunkQueue::num_free_entries() const
+{
+    const u64 read = read_position.load(std::memory_order_relaxed);
+    const u64 write = write_position.load(std::memory_order_relaxed);
+    const i64 num_used_entries = std::max((i64)write - (i64)read, (i64)0);
+    return MAX_ENTRIES - (i32)std::min(num_used_entries, (i64)MAX_ENTRIES);
+}
+
+Landscape::RequestHandle
+Landscape::ChunkQueue::take_next_request()
+{
+    u64 position = read_position.load(std::memory_order_relaxed);
+    Entry *entry;
+    for (;;)
     {
-        return nullptr;
+        entry = &entries[position % MAX_ENTRIES];
+        const u64 sequence = entry->sequence.load(std::memory_order_acquire);
+        const i64 difference = (i64)sequence - (i64)(position + 1);
+
+        if (difference == 0)
+        {
+            if (read_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // There is not an entry to consume, return an invalid handle.
+            return RequestHandle();
+        }
+        else
+        {
+            position = read_position.load(std::memory_order_relaxed);
+        }
     }
+
+    const RequestHandle request = entry->request;
+    // NOTE: The entry can be written again on the next lap around the array.
+    entry->sequence.store(position + MAX_ENTRIES, std::memory_order_release);
+    return request;
 }
 
 void
@@ -1011,14 +2641,10 @@ Landscape::remove_block(Vec3f ray_origin, Vec3f ray_direction)
     // work with negative directions.
     // http://citeseerx.ist.psu.edu/viewdoc/download?doi=10.1.1.42.3443&rep=rep1&type=pdf
 
-    chunks_mutex.lock_high_priority(); // LOCK
-    // Find the block where the ray starts.
-    const Vec3f offset_from_origin = ray_origin - origin;
-    LT_Assert(offset_from_origin.x >= 0 && offset_from_origin.y >= 0 && offset_from_origin.z >= 0);
-
-    i32 abx = std::floor(offset_from_origin.x / Chunk::BLOCK_SIZE);
-    i32 aby = std::floor(offset_from_origin.y / Chunk::BLOCK_SIZE);
-    i32 abz = std::floor(offset_from_origin.z / Chunk::BLOCK_SIZE);
+    // Find the block where the ray starts. Blocks are counted from the world origin.
+    i32 abx = std::floor(ray_origin.x / Chunk::BLOCK_SIZE);
+    i32 aby = std::floor(ray_origin.y / Chunk::BLOCK_SIZE);
+    i32 abz = std::floor(ray_origin.z / Chunk::BLOCK_SIZE);
 
     const i32 step_x = lt::sign_float(ray_direction.x);
     const i32 step_y = lt::sign_float(ray_direction.y);
@@ -1042,18 +2668,18 @@ Landscape::remove_block(Vec3f ray_origin, Vec3f ray_direction)
     };
 
     // Maximum amount we can advance (in t) in order to meet one of the axis boundaries.
-    // f32 t_max_x = t_delta_x * (1 - fraction_pos(offset_from_origin.x / Chunk::BLOCK_SIZE));
+    // f32 t_max_x = t_delta_x * (1 - fraction_pos(ray_origin.x / Chunk::BLOCK_SIZE));
     f32 t_max_x = (step_x > 0)
-        ? t_delta_x * (1 - fraction_pos(offset_from_origin.x / Chunk::BLOCK_SIZE))
-        : t_delta_x * fraction_pos(offset_from_origin.x / Chunk::BLOCK_SIZE);
+        ? t_delta_x * (1 - fraction_pos(ray_origin.x / Chunk::BLOCK_SIZE))
+        : t_delta_x * fraction_pos(ray_origin.x / Chunk::BLOCK_SIZE);
 
     f32 t_max_y = (step_y > 0)
-        ? t_delta_y * (1 - fraction_pos(offset_from_origin.y / Chunk::BLOCK_SIZE))
-        : t_delta_y * fraction_pos(offset_from_origin.y / Chunk::BLOCK_SIZE);
+        ? t_delta_y * (1 - fraction_pos(ray_origin.y / Chunk::BLOCK_SIZE))
+        : t_delta_y * fraction_pos(ray_origin.y / Chunk::BLOCK_SIZE);
 
     f32 t_max_z = (step_z > 0)
-        ? t_delta_z * (1 - fraction_pos(offset_from_origin.z / Chunk::BLOCK_SIZE))
-        : t_delta_z * fraction_pos(offset_from_origin.z / Chunk::BLOCK_SIZE);
+        ? t_delta_z * (1 - fraction_pos(ray_origin.z / Chunk::BLOCK_SIZE))
+        : t_delta_z * fraction_pos(ray_origin.z / Chunk::BLOCK_SIZE);
 
     i32 blocks_traversed = 0;
     for (;;) {
@@ -1075,73 +2701,18 @@ Landscape::remove_block(Vec3f ray_origin, Vec3f ray_direction)
             }
         }
 
-        const i32 bx = abx % Chunk::NUM_BLOCKS_PER_AXIS;
-        const i32 by = aby % Chunk::NUM_BLOCKS_PER_AXIS;
-        const i32 bz = abz % Chunk::NUM_BLOCKS_PER_AXIS;
-
-        const i32 cx = abx / Chunk::NUM_BLOCKS_PER_AXIS;
-        const i32 cy = aby / Chunk::NUM_BLOCKS_PER_AXIS;
-        const i32 cz = abz / Chunk::NUM_BLOCKS_PER_AXIS;
+        // NOTE: The ray cannot edit blocks above or below the world, for example when the camera
+        // is above it.
+        if (aby < 0 || aby >= TOTAL_BLOCKS_Y)
+            break;
 
-        Chunk *chunk = chunk_ptrs[cx][cy][cz].get();
-        if (chunk->blocks[bx][by][bz] != BlockType_Air)
+        if (block_exists(abx, aby, abz))
         {
-            chunk->blocks[bx][by][bz] = BlockType_Air;
-            chunk->create_request();
-
-            // Regenerate the current chunk mesh.
-            m_chunks_to_process_queues[QP_High].insert(chunk->request, &m_chunks_to_process_semaphore);
-
-            // If the block changed is in the boundary of another chunk,
-            // update the neighboring chunk as well.
-            if (bx == 0)
-            {
-                Chunk *left_chunk = chunk_ptrs[cx-1][cy][cz].get();
-                left_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(left_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
-            if (bx == Chunk::NUM_BLOCKS_PER_AXIS-1)
-            {
-                Chunk *right_chunk = chunk_ptrs[cx+1][cy][cz].get();
-                right_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(right_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
-            if (by == 0)
-            {
-                Chunk *bottom_chunk = chunk_ptrs[cx][cy-1][cz].get();
-                bottom_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(bottom_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
-            if (by == Chunk::NUM_BLOCKS_PER_AXIS-1)
-            {
-                Chunk *top_chunk = chunk_ptrs[cx][cy+1][cz].get();
-                top_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(top_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
-            if (bz == 0)
-            {
-                Chunk *back_chunk = chunk_ptrs[cx][cy][cz-1].get();
-                back_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(back_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
-            if (bz == Chunk::NUM_BLOCKS_PER_AXIS-1)
-            {
-                Chunk *front_chunk = chunk_ptrs[cx][cy][cz+1].get();
-                front_chunk->create_request();
-                m_chunks_to_process_queues[QP_High].insert(front_chunk->request,
-                                                          &m_chunks_to_process_semaphore);
-            }
+            edit_block(abx, aby, abz, BlockType_Air);
             break;
         }
 
         blocks_traversed++;
         if (blocks_traversed == 6) break; // TODO: remove hardcoded number of blocks.
     }
-
-    chunks_mutex.unlock_high_priority(); // UNLOCK
 }
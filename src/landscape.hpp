@@ -2,93 +2,358 @@
 #define __LANDSCAPE_HPP__
 
 #include <thread>
-#include <functional>
+#include <memory>
 #include <vector>
 #include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include "pool_allocator.hpp"
 
 #include "lt_core.hpp"
 #include "lt_math.hpp"
-#include "pool_allocator.hpp"
-#include "semaphore.hpp"
 #include "vertex.hpp"
+#include "mesh_cache.hpp"
+#include "block_storage.hpp"
+#include "region_file.hpp"
 
 struct Camera;
 struct ResourceManager;
 struct osn_context;
-struct ChunkNoise;
 struct Memory;
 struct Input;
+struct PaddedChunk;
+struct EditableChunkMesh;
+struct IOTaskManager;
+struct JobSystem;
 
-enum BlockType
+enum BlockFace
 {
-    BlockType_Air,
-    BlockType_Terrain,
-    BlockType_Count,
+    BlockFace_Left = 0,   // -x
+    BlockFace_Right = 1,  // +x
+    BlockFace_Top = 2,    // +y
+    BlockFace_Bottom = 3, // -y
+    BlockFace_Front = 4,  // +z
+    BlockFace_Back = 5,   // -z
+    BlockFace_Count = 6,
 };
 
 struct Landscape
 {
-    constexpr static i32 NUM_CHUNKS_X = 18;
+    // Height of the world in chunks. Along x and z the world has no bounds, the columns of chunks
+    // around the camera are loaded when they come into view and unloaded once they are far enough.
     constexpr static i32 NUM_CHUNKS_Y = 7;
-    constexpr static i32 NUM_CHUNKS_Z = 18;
-    constexpr static i32 NUM_CHUNKS = NUM_CHUNKS_X*NUM_CHUNKS_Y*NUM_CHUNKS_Z;
+    // Chunks are meshed with cells of 1, 2 or 4 blocks depending on their distance to the camera.
+    constexpr static i32 NUM_LODS = 3;
+    // Horizontal distance in chunks from the center column within which chunks are generated and
+    // rendered. The memory of the chunks is allocated for the maximum distance, so the distance
+    // can change at runtime without reallocating anything.
+    constexpr static i32 MIN_VIEW_DISTANCE = 2;
+    constexpr static i32 DEFAULT_VIEW_DISTANCE = 9;
+    constexpr static i32 MAX_VIEW_DISTANCE = 16;
+    // Columns that leave the view distance are unloaded once they are this many chunks beyond it,
+    // so the camera can go back and forth over a chunk boundary without generating them again.
+    constexpr static i32 UNLOAD_MARGIN = 2;
+    // Every loaded column fits in a square of MAX_COLUMNS_PER_AXIS columns around the center column.
+    constexpr static i32 MAX_COLUMNS_PER_AXIS = 2*(MAX_VIEW_DISTANCE + UNLOAD_MARGIN) + 1;
+    constexpr static i32 MAX_CHUNKS = MAX_COLUMNS_PER_AXIS*MAX_COLUMNS_PER_AXIS*NUM_CHUNKS_Y;
+    // Generated chunks of the unloaded columns are kept in memory for a while, enough for the two
+    // rows of columns crossed when the camera goes back and forth beyond the unload margin.
+    constexpr static i32 MAX_EVICTED_CHUNKS = 2*MAX_COLUMNS_PER_AXIS*NUM_CHUNKS_Y;
+    // Only the chunks in view are rendered, and they fit in the square of the maximum view distance.
+    constexpr static i32 MAX_CHUNKS_IN_VIEW = (2*MAX_VIEW_DISTANCE + 1)*(2*MAX_VIEW_DISTANCE + 1)*NUM_CHUNKS_Y;
+    // Frame time the automatic view distance tries to stay under.
+    constexpr static f32 FRAME_TIME_BUDGET_MS = 1000.0f / 60.0f;
 
     struct Chunk;
+
+    // Strategies used for turning the blocks of a chunk into triangles.
+    enum MeshingMode
+    {
+        // One quad is emitted for every visible block face.
+        MeshingMode_Naive = 0,
+        // Coplanar visible faces with the same texture layer are merged into bigger quads.
+        MeshingMode_Greedy = 1,
+        // Same quads as the greedy mode, but visible faces are found from the occupancy masks
+        // a whole row of blocks at a time.
+        MeshingMode_Binary = 2,
+        MeshingMode_Count = 3,
+    };
+
+    // How the blocks of a chunk meshed with a level of detail are merged into bigger cells.
+    enum LodDownsampling
+    {
+        // A cell is solid if any of its blocks is solid. Distant terrain keeps every overhang and
+        // thin feature, so no holes appear, but the terrain looks bloated.
+        LodDownsampling_AnySolid = 0,
+        // A cell is solid if at least half of its blocks are solid. Thin features disappear, but
+        // the silhouette of the terrain is closer to the real one and fewer quads are emitted.
+        LodDownsampling_Majority = 1,
+        LodDownsampling_Count = 2,
+    };
+
+    enum NoisePrecision
+    {
+        NoisePrecision_F64 = 0,
+        NoisePrecision_F32 = 1,
+    };
+
+    enum NoiseSampling
+    {
+        // The noise is evaluated for every column of blocks.
+        NoiseSampling_Full = 0,
+        // The noise is evaluated on a coarser lattice and interpolated for the blocks in between.
+        NoiseSampling_Bilinear = 1,
+        NoiseSampling_Bicubic = 2,
+    };
+
+    struct NoiseSamplingSettings
+    {
+        NoiseSampling sampling;
+        // Distance in blocks between lattice points, it should divide the number of blocks per axis.
+        i32           lattice_spacing;
+    };
+
+    enum TerrainMode
+    {
+        // Blocks are solid up to the height of the terrain.
+        TerrainMode_Heightmap = 0,
+        // Blocks around the height of the terrain are carved or added by 3D noise, which creates
+        // caves and overhangs.
+        TerrainMode_Density = 1,
+        TerrainMode_Count = 2,
+    };
+
+    // Maximum distance in blocks from the heightmap where the 3D noise can change the blocks.
+    constexpr static i32 DENSITY_NOISE_AMPLITUDE = 8;
+    constexpr static f64 DENSITY_NOISE_FREQUENCY = 1.0 / 24.0;
+    // Distance in blocks between the points where the 3D noise is evaluated.
+    constexpr static i32 DENSITY_LATTICE_SPACING_XZ = 8;
+    constexpr static i32 DENSITY_LATTICE_SPACING_Y = 4;
+
+    // Maximum height difference in blocks between sampled and full resolution terrain that is
+    // expected to go unnoticed. Sampling settings above it are refused, which leaves bicubic
+    // sampling every 2 blocks as the coarsest lattice for the terrain of world.cpp.
+    constexpr static i32 MAX_NOISE_SAMPLING_ERROR = 1;
 private:
     // -----------------------------------------------------------------
     // Queue definition for asynchronously loading chunks
     // -----------------------------------------------------------------
-    struct QueueRequest
+    enum RequestType
+    {
+        // Generates the blocks of the chunk, which is meshed afterwards.
+        RequestType_Generate,
+        RequestType_Mesh,
+    };
+
+    // Refers to a request of the request pool. The handle is stale once the generation of the
+    // request changes, which happens when the request is cancelled.
+    struct RequestHandle
     {
-        // TODO: As soon as multiple threads start modifying this object,
-        // introduce a mutex.
-        QueueRequest(Chunk *chunk) : chunk(chunk), processed(false) {}
+        constexpr static u32 INVALID_INDEX = 0xFFFFFFFF;
+
+        u32 index = INVALID_INDEX;
+        u32 generation = 0;
 
+        inline bool is_valid() const { return index != INVALID_INDEX; }
+    };
+
+    struct QueueRequest
+    {
         Chunk *chunk;
+        RequestType type;
+        // Copy of the chunk origin, so the blocks can be generated without holding the lock.
+        Vec3f chunk_origin;
+        // Incremented when the request is taken from the pool and when it is cancelled.
+        std::atomic<u32> generation;
         std::atomic<bool> processed;
-        std::vector<Vertex_PLN> vertexes;
+        ChunkVertexBuffer vertexes;
+        u32 face_num_quads[BlockFace_Count];
+        // Next request in the free list while the request is in the pool.
+        std::atomic<u32> next_free;
     };
 
+    struct VertexBufferPool
+    {
+        constexpr static i32 MAX_BUFFERS = 64;
+
+        VertexBufferPool();
+
+        // Returns an empty buffer, which keeps the capacity it had when it was given back.
+        ChunkVertexBuffer take();
+        // Takes the memory of the buffer, leaving it without any capacity.
+        void give_back(ChunkVertexBuffer &buffer);
+
+        std::vector<ChunkVertexBuffer> buffers;
+        std::mutex mutex;
+    };
+
+    //
+    // Fixed set of requests, so queueing chunks does not allocate. A request is owned by the handle
+    // that travels through the queues, and whoever holds the handle gives the request back when it
+    // is done with it or finds that it is stale. Cancelling only changes the generation, so the
+    // chunk does not need to know where its request is.
+    //
+    struct RequestPool
+    {
+        // Every request is either in one of the queues or being handled by a thread.
+        constexpr static i32 MAX_REQUESTS = 4*MAX_CHUNKS + 64;
+
+        // Vertex buffers of the requests go back to the given pool along with the requests.
+        explicit RequestPool(VertexBufferPool *vertex_buffers);
+
+        // Returns an invalid handle when every request is taken.
+        RequestHandle take(Chunk *chunk, RequestType type, Vec3f chunk_origin);
+        void give_back(RequestHandle handle);
+        // Makes the handle stale, unless the request was already cancelled or given back.
+        void cancel(RequestHandle handle);
+
+        inline bool is_current(RequestHandle handle) const
+        {
+            return requests[handle.index].generation.load(std::memory_order_acquire) == handle.generation;
+        }
+        inline QueueRequest &operator[](RequestHandle handle)
+        {
+            return requests[handle.index];
+        }
+
+    private:
+        QueueRequest requests[MAX_REQUESTS];
+        VertexBufferPool *vertex_buffers;
+        // Index of the first free request in the low bits, and a counter in the high bits that
+        // changes on every push and pop, so a thread holding an old head cannot pop it again.
+        std::atomic<u64> free_head;
+    };
+
+    //
+    // Bounded FIFO queue that any number of threads can insert to and take from without a lock.
+    // Each entry has a sequence number telling if it is ready to be written or read on the current
+    // lap around the array, so threads only contend on the position they advance.
+    //
     struct ChunkQueue
     {
         // FIXME: Having multiple queues, some queues may not need such number of entries,
         // so this can be a waste of space.
-        static constexpr i32 MAX_ENTRIES = NUM_CHUNKS;
+        static constexpr i32 MAX_ENTRIES = MAX_CHUNKS;
+
+        ChunkQueue();
+
+        // Returns false when the queue is full, in which case the request is not added.
+        bool insert(RequestHandle request);
+        // Returns an invalid handle when the queue is empty.
+        RequestHandle take_next_request();
+        // NOTE: Only an estimate while other threads use the queue.
+        i32 num_free_entries() const;
+
+    private:
+        struct Entry
+        {
+            // Equal to the write position when the entry can be written, and to the write
+            // position plus one when it can be read.
+            std::atomic<u64> sequence;
+            RequestHandle    request;
+        };
 
-        struct Request
+        Entry entries[MAX_ENTRIES];
+        // NOTE: Kept in separate cache lines, so inserting does not slow down taking requests.
+        alignas(64) std::atomic<u64> write_position;
+        alignas(64) std::atomic<u64> read_position;
+    };
+
+    //
+    // Loaded chunks by their coordinates, in an open addressing table with linear probing. The table
+    // is allocated once with at least twice as many slots as there can be loaded chunks, so the
+    // probes stay short and loading a chunk never allocates. The chunks are also kept packed in an
+    // array, so going over them does not look at the empty slots.
+    //
+    struct ChunkMap
+    {
+        constexpr static i32 NUM_SLOT_BITS = 15;
+        constexpr static u32 NUM_SLOTS = 1u << NUM_SLOT_BITS;
+
+        ChunkMap();
+
+        // Returns nullptr when the chunk is not in the map.
+        Chunk *find(i32 cx, i32 cy, i32 cz) const;
+        void insert(Chunk *chunk);
+        void remove(const Chunk *chunk);
+
+        // Chunk at the index, from 0 to num_chunks(). Used for going over every chunk of the map,
+        // which should not change in the meantime since removing a chunk moves the last one to its index.
+        inline Chunk *chunk_at(i32 index) const { return m_chunks[index]; }
+        inline i32 num_chunks() const { return m_num_chunks; }
+
+    private:
+        struct Slot
         {
+            u64    key;
             Chunk *chunk;
+            // Index of the chunk in the packed array.
+            i32    index;
         };
 
-        void insert(const std::shared_ptr<QueueRequest> &request, Semaphore *semaphore);
-        std::shared_ptr<QueueRequest> take_next_request();
+        static u64 make_key(i32 cx, i32 cy, i32 cz);
+        static u32 home_slot(u64 key);
+        // Returns the slot holding the key, or the empty slot where it would go.
+        u32 find_slot(u64 key) const;
 
-        // The entries array is a circular FIFO queue.
-        std::shared_ptr<QueueRequest> requests[MAX_ENTRIES];
-        std::mutex mutable mutex;
-        std::atomic<i32> read_index = 0;
-        std::atomic<i32> write_index = 0;
+        Slot   m_slots[NUM_SLOTS];
+        Chunk *m_chunks[MAX_CHUNKS];
+        // Slot of each chunk of the packed array.
+        u32    m_chunk_slots[MAX_CHUNKS];
+        i32    m_num_chunks;
     };
 
 public:
+    struct MeshingStats
+    {
+        u64 num_chunks_meshed;
+        // Allocations of chunk vertex buffers, as counted by their allocator. Meshing, the mesh cache
+        // and the editable meshes all use them.
+        u64 num_allocations;
+        u64 num_cache_hits;
+        u64 num_cache_misses;
+        usize cache_used_bytes;
+        usize cache_max_bytes;
+    };
+
     struct VAOArray
     {
         struct Entry
         {
             const u32 vao;
             const u32 vbo;
-            u32 num_vertices_used;
+            u32 num_quads;
+            // When the quads are sorted by face direction, the quads of each direction are stored
+            // one after the other, which allows skipping the directions facing away from the camera.
+            u32 face_num_quads[BlockFace_Count];
+            bool is_sorted_by_face;
+            // Origin of the chunk that uses this entry, passed to the shaders as a uniform
+            // since the vertex positions are relative to it.
+            Vec3f origin;
             bool is_used;
             Entry();
         };
 
+        VAOArray();
+
         isize take_free_entry();
         void free_entry(isize index);
 
-        Entry vaos[NUM_CHUNKS];
+        Entry vaos[MAX_CHUNKS_IN_VIEW];
+        // Index buffer shared by every chunk, see Vertex_Chunk.
+        const u32 quad_ebo;
     };
 
+    //
+    // Protects the layout of the landscape, that is, which chunks are loaded and which ones are in
+    // view. The blocks of each chunk are protected by the mutex of the chunk instead.
+    //
+    // The worker threads lock it with low priority, which is a shared lock, so they can work on
+    // different chunks at the same time. The main thread is the only one that changes the layout,
+    // and it locks it with high priority, which is an exclusive lock that the workers wait for
+    // before taking the shared lock again.
+    //
     struct ChunksMutex
     {
         void lock_high_priority()
@@ -100,64 +365,120 @@ public:
         }
         void unlock_high_priority()
         {
-            m_hpt_done_signal.notify_one();
             m_mutex.unlock();
+            // NOTE: The wait mutex is taken so the signal cannot be sent between a worker
+            // checking m_hpt_waiting and starting to wait.
+            {
+                std::lock_guard<std::mutex> lock(m_wait_mutex);
+            }
+            m_hpt_done_signal.notify_all();
         }
         void lock_low_priority()
         {
-            std::unique_lock<decltype(m_mutex)> lock(m_mutex);
-            while (m_hpt_waiting)
-                m_hpt_done_signal.wait(lock);
-            lock.release();
+            if (m_hpt_waiting)
+            {
+                std::unique_lock<std::mutex> lock(m_wait_mutex);
+                while (m_hpt_waiting)
+                    m_hpt_done_signal.wait(lock);
+            }
+            m_mutex.lock_shared();
         }
         void unlock_low_priority()
         {
-            m_hpt_done_signal.notify_one();
-            m_mutex.unlock();
+            m_mutex.unlock_shared();
         }
     private:
-        std::mutex m_mutex;
+        std::shared_mutex m_mutex;
+        std::mutex m_wait_mutex;
         std::atomic_bool m_hpt_waiting = false;
         std::condition_variable m_hpt_done_signal;
     };
 
     struct Chunk
     {
-        constexpr static i32 NUM_BLOCKS_PER_AXIS = 16;
-        constexpr static i32 NUM_BLOCKS = NUM_BLOCKS_PER_AXIS*NUM_BLOCKS_PER_AXIS*NUM_BLOCKS_PER_AXIS;
+        constexpr static i32 NUM_BLOCKS_PER_AXIS = BlockStorage::NUM_BLOCKS_PER_AXIS;
+        constexpr static i32 NUM_BLOCKS = BlockStorage::NUM_BLOCKS;
         constexpr static i32 BLOCK_SIZE = 1;
         constexpr static i32 SIZE = BLOCK_SIZE * NUM_BLOCKS_PER_AXIS;
+        // Worst case number of visible faces, which happens when blocks are placed as a 3D checkerboard.
+        constexpr static i32 MAX_QUADS = 3 * NUM_BLOCKS;
 
-        Chunk(Vec3f origin, VAOArray *vao_array, BlockType fill_type = BlockType_Air);
+        Chunk(i32 cx, i32 cy, i32 cz, VAOArray *vao_array, RequestPool *request_pool,
+              BlockType fill_type = BlockType_Air);
         ~Chunk();
         Chunk(Chunk &chunk) = delete;
         Chunk &operator=(const Chunk &chunk) = delete;
 
-        void create_request();
+        // Cancels the current request of the chunk and takes a new one, the request is invalid
+        // if the pool ran out of requests.
+        void create_request(RequestType type = RequestType_Mesh);
         void cancel_request();
+        // Entry of the vao array used for rendering the chunk, which is only taken while the
+        // chunk has something to render.
+        VAOArray::Entry &take_entry();
+        void release_entry();
+
+        void set_block(i32 bx, i32 by, i32 bz, BlockType type);
+        // Recomputes the occupancy masks, should be called after writing to the blocks directly.
+        void rebuild_occupancy();
+
+        inline bool is_solid(i32 bx, i32 by, i32 bz) const
+        {
+            return (occupancy_y[bx][bz] >> by) & 1;
+        }
 
     public:
-        BlockType blocks[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS];
+        // Protects the blocks, the occupancy masks, the edits and the request of the chunk.
+        // Threads other than the main thread should also hold the chunks mutex while using it,
+        // so the chunk is not destroyed under them.
+        // NOTE: A thread never waits for the exclusive lock of a chunk while holding the lock of
+        // another chunk, and the shared locks of several chunks are taken in address order
+        // through ChunkReadLocks, so the chunk locks cannot deadlock.
+        mutable std::shared_mutex mutex;
+        // NOTE: Blocks should be modified through set_block, otherwise rebuild_occupancy has
+        // to be called in order to keep the occupancy masks in sync.
+        BlockStorage blocks;
+        // One bit per block telling if it is solid, for rows of blocks along each one of the axes.
+        u16       occupancy_x[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]; // [y][z], bit x
+        u16       occupancy_y[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]; // [x][z], bit y
+        u16       occupancy_z[NUM_BLOCKS_PER_AXIS][NUM_BLOCKS_PER_AXIS]; // [x][y], bit z
+        // Coordinates of the chunk in chunks from the world origin.
+        const i32 cx;
+        const i32 cy;
+        const i32 cz;
         Vec3f     origin;
-        isize     entry_index;
-        std::shared_ptr<QueueRequest> request;
+        // Index into the vao array, or -1 if the chunk does not have an entry.
+        std::atomic<isize> entry_index;
+        // Index into the landscape editable meshes, or -1 if the chunk does not have one.
+        i32       editable_mesh_index;
+        // Level of detail used the next time the chunk is meshed.
+        std::atomic<i32>   lod;
+        // Chunks are created empty and their blocks are generated by the worker threads,
+        // until then the chunk only contains air and it is not meshed.
+        std::atomic<bool>  is_generated;
+        // The request of the chunk could not be queued because the queue was full, so the main
+        // thread queues it again later.
+        std::atomic<bool>  is_request_deferred;
+        // The chunk is within the view distance. Chunks outside of it are neither generated
+        // nor rendered, and the meshers treat them as air like the chunks that are not loaded.
+        bool      is_in_view;
+        // Blocks changed since the chunk was generated, replayed on top of the generated blocks
+        // when the chunk comes back to the landscape.
+        ChunkEditLog edits;
+        // The edits changed since they were saved, so they are saved again when the chunk
+        // leaves the landscape.
+        bool      is_dirty;
+        RequestHandle request;
     private:
-        VAOArray *m_vao_array;
+        VAOArray    *m_vao_array;
+        RequestPool *m_request_pool;
     };
 
-    using ChunkPtr = std::unique_ptr<Chunk,std::function<void(Chunk*)>>;
-    // using ChunkPtr = std::unique_ptr<Chunk>;
-
-    constexpr static i32 TOTAL_BLOCKS_X = NUM_CHUNKS_X * Chunk::NUM_BLOCKS_PER_AXIS;
     constexpr static i32 TOTAL_BLOCKS_Y = NUM_CHUNKS_Y * Chunk::NUM_BLOCKS_PER_AXIS;
-    constexpr static i32 TOTAL_BLOCKS_Z = NUM_CHUNKS_Z * Chunk::NUM_BLOCKS_PER_AXIS;
-
-    constexpr static i32 SIZE_X = TOTAL_BLOCKS_X * Chunk::BLOCK_SIZE;
     constexpr static i32 SIZE_Y = TOTAL_BLOCKS_Y * Chunk::BLOCK_SIZE;
-    constexpr static i32 SIZE_Z = TOTAL_BLOCKS_Z * Chunk::BLOCK_SIZE;
 
 
-    Landscape(Memory &memory, i32 seed, f64 amplitude, f64 frequency,
+    Landscape(Memory &memory, IOTaskManager *io_task_manager, i32 seed, f64 amplitude, f64 frequency,
               i32 num_octaves, f64 lacunarity, f64 gain);
     ~Landscape();
 
@@ -167,33 +488,106 @@ public:
     Landscape &operator=(const Landscape&) = delete;
     Landscape &operator=(const Landscape&&) = delete;
 
-    std::vector<Vertex_PLN> update_chunk_buffer(Chunk *chunk);
+    // Meshes the padded chunk into the given buffer, which is cleared first.
+    void update_chunk_buffer(const PaddedChunk &padded, MeshingMode mode, ChunkVertexBuffer &vertices);
+    // Copies the blocks of the chunk and the bordering blocks of its neighbors, taking their locks.
+    // The chunks mutex should be held by the caller, unless it is the main thread.
+    void gather_padded_chunk(Chunk *chunk, PaddedChunk *padded);
+    // Blocks are given by their coordinates from the world origin. Blocks of chunks that are not
+    // loaded are treated as air.
     bool block_exists(i32 abs_block_xi, i32 abs_block_yi, i32 abs_block_zi);
+    // Changes a block and patches the meshes around it in place, so the change is visible on
+    // the same frame. Blocks of chunks that are not loaded are left alone. It should only be
+    // called from the main thread.
+    void edit_block(i32 abx, i32 aby, i32 abz, BlockType type);
     void update(const Camera &camera, const Input &input);
     void generate();
 
+    // Changes the mesher used by the worker threads. Every chunk is remeshed over the next frames.
+    void set_meshing_mode(MeshingMode mode);
+    inline MeshingMode meshing_mode() const { return m_meshing_mode; }
+
+    // Chunks whose center is farther than the given horizontal distance from the camera are
+    // meshed with the given level of detail, lod being between 1 and NUM_LODS-1.
+    void set_lod_distance(i32 lod, f32 distance);
+    // Changes how the chunks with a level of detail are downsampled. Every chunk is remeshed
+    // over the next frames.
+    void set_lod_downsampling(LodDownsampling downsampling);
+    inline LodDownsampling lod_downsampling() const { return m_lod_downsampling; }
+
+    // Precision used for evaluating the terrain noise. With F32 twice as many points are evaluated
+    // at once, but the terrain is slightly different from the one generated with F64.
+    void set_noise_precision(NoisePrecision precision);
+    inline NoisePrecision noise_precision() const { return m_noise_precision; }
+
+    // How the terrain noise is sampled for the columns generated from now on. The error of the
+    // sampling is measured on the columns of the landscape first, and the sampling is refused
+    // when the error is above MAX_NOISE_SAMPLING_ERROR.
+    bool set_noise_sampling(NoiseSampling sampling, i32 lattice_spacing);
+    inline NoiseSamplingSettings noise_sampling() const { return m_noise_sampling; }
+
+    // Compares the heights of the landscape columns between every sampling and full resolution
+    // sampling, and logs the error along with the number of noise evaluations.
+    void debug_measure_noise_sampling_error();
+
+    // Chunks generated from now on use the given terrain mode. The heightmap is the default, so
+    // existing worlds keep their terrain. Saved edits are replayed on the terrain of the current
+    // mode, so the mode should be chosen before generating the landscape.
+    inline void set_terrain_mode(TerrainMode mode) { m_terrain_mode = mode; }
+    inline TerrainMode terrain_mode() const { return m_terrain_mode; }
+
+    // Generates the blocks of every chunk of the landscape with each terrain mode, and logs how long it took.
+    void debug_benchmark_generation();
+
+    // Meshes every chunk with all of the meshing modes and logs triangle counts and timings.
+    void debug_compare_meshing_modes();
+
+    MeshingStats meshing_stats() const;
+
+    // The landscape grows or shrinks towards the given view distance one ring of chunks at a time.
+    // Setting the view distance disables the automatic view distance.
+    void set_view_distance(i32 view_distance);
+    inline i32 view_distance() const { return m_view_distance; }
+    // With the automatic view distance, the view distance shrinks when frames take longer than
+    // FRAME_TIME_BUDGET_MS or the workers cannot keep up, and grows while there is time to spare.
+    void set_auto_view_distance(bool enabled);
+    inline bool auto_view_distance() const { return m_auto_view_distance; }
+    // Should be called once per rendered frame.
+    void report_frame_time(f32 frame_time_ms);
+
+    // Center of the column the landscape is loaded around, at half the height of the world.
     inline Vec3f center() const
     {
-        return origin + 0.5f*Vec3f(SIZE_X, SIZE_Y, SIZE_Z);
+        return Vec3f((m_center_column_x + 0.5f)*Chunk::SIZE, 0.5f*SIZE_Y, (m_center_column_z + 0.5f)*Chunk::SIZE);
     }
 
-private:
-    void chunk_deleter(Chunk *chunk);
-
 public:
     ChunksMutex chunks_mutex;
 
-    // Chunks matrix.
-    ChunkPtr chunk_ptrs[NUM_CHUNKS_X][NUM_CHUNKS_Y][NUM_CHUNKS_Z];
-
-    // Where the (left, bottom, back) corner of the landscape starts.
-    Vec3f   origin;
+    // Chunk at the given coordinates in chunks from the world origin, or nullptr if it is not loaded.
+    inline Chunk *find_chunk(i32 cx, i32 cy, i32 cz) const
+    {
+        return m_chunk_map.find(cx, cy, cz);
+    }
 
     // Structure that contains all of the VBOs and VAOs necessary to render
     // the chunks.
     VAOArray vao_array;
 
 private:
+    // Same as find_chunk, but chunks out of view are treated as not loaded, like the meshers do.
+    inline Chunk *find_chunk_in_view(i32 cx, i32 cy, i32 cz) const
+    {
+        Chunk *chunk = m_chunk_map.find(cx, cy, cz);
+        return (chunk && chunk->is_in_view) ? chunk : nullptr;
+    }
+
+    // Coordinates in chunks of the column the landscape is loaded around. It follows the camera,
+    // lagging one chunk behind so it does not move back and forth on a chunk boundary.
+    i32                 m_center_column_x;
+    i32                 m_center_column_z;
+    ChunkMap            m_chunk_map;
+
     const i32           m_seed;
     const f64           m_amplitude;
     const f64           m_frequency;
@@ -201,22 +595,191 @@ private:
     const f64           m_lacunarity;
     const f64           m_gain;
 
-    std::vector<std::thread> m_threads;
-    std::atomic<bool>        m_threads_should_run;
+    // Chunks are generated and meshed by jobs of the job system, one job per queued request.
+    JobSystem               *m_job_system;
+    std::atomic<bool>        m_jobs_should_run;
+    std::atomic<i32>         m_num_pending_jobs;
 
     osn_context  *m_simplex_ctx;
+    std::atomic<NoisePrecision> m_noise_precision;
+    std::atomic<NoiseSamplingSettings> m_noise_sampling;
+    std::atomic<TerrainMode> m_terrain_mode;
+
+    std::atomic<MeshingMode> m_meshing_mode;
+    std::atomic<LodDownsampling> m_lod_downsampling;
+    // Every column in view when the meshing mode or the lod downsampling changed is within the
+    // maximum view distance of the center column at that moment, so the remeshing goes over
+    // that square of columns. Columns that come into view later are meshed with the new settings.
+    constexpr static i32 NUM_REMESH_COLUMNS = (2*MAX_VIEW_DISTANCE + 1)*(2*MAX_VIEW_DISTANCE + 1);
+    // Index of the next column of the square that should be remeshed. When it reaches
+    // NUM_REMESH_COLUMNS there is nothing left to remesh.
+    i32                      m_remesh_cursor;
+    i32                      m_remesh_center_x;
+    i32                      m_remesh_center_z;
+
+    // Chunks that were edited recently keep an editable mesh, the least recently edited chunk
+    // loses its mesh when a new one is needed.
+    struct EditableMeshSlot
+    {
+        Chunk *chunk;
+        u64    last_edit;
+        // Number of quads that fit in the vbo of the chunk without reallocating it.
+        i32    capacity_quads;
+        std::unique_ptr<EditableChunkMesh> mesh;
+    };
+    constexpr static i32 MAX_EDITABLE_MESHES = 16;
+    EditableMeshSlot             m_editable_meshes[MAX_EDITABLE_MESHES];
+    u64                          m_num_edits;
+    // Snapshot used by the main thread for editing blocks.
+    std::unique_ptr<PaddedChunk> m_edit_padded;
+
+    VertexBufferPool         m_vertex_buffer_pool;
+    MeshCache                m_mesh_cache;
+    std::atomic<u64>         m_num_chunks_meshed;
+
+    // Minimum distance of each level of detail, starting from lod 1.
+    f32 m_lod_distances[NUM_LODS-1];
+
+    // Terrain heights of a column of chunks, shared by every chunk in the column.
+    struct ColumnHeightmap
+    {
+        // Coordinates of the column in chunks, from the world origin.
+        i32  column_x;
+        i32  column_z;
+        bool is_valid;
+        // Absolute y index of the highest solid block, indexed as [x][z].
+        i32  heights[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS];
+        std::mutex mutex;
+    };
+    // Indexed by the column coordinates modulo MAX_COLUMNS_PER_AXIS, so every loaded column has its
+    // own heightmap, and a column that is loaded takes the place of one that was unloaded.
+    ColumnHeightmap m_column_heightmaps[MAX_COLUMNS_PER_AXIS][MAX_COLUMNS_PER_AXIS];
+
+    // Blocks generated by a worker thread, before being copied into their chunk.
+    struct GeneratedBlocks
+    {
+        BlockType blocks[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS];
+        // Saved edits of the chunk, which were already applied to the blocks.
+        ChunkEditLog edits;
+    };
 
     memory::PoolAllocator m_chunks_allocator;
 
+    // Generated chunks of the unloaded columns, taken back instead of being generated again if the
+    // camera returns. The least recently evicted chunk is destroyed when a slot is needed.
+    struct EvictedChunkSlot
+    {
+        Chunk *chunk;
+        u64    eviction;
+    };
+    EvictedChunkSlot m_evicted_chunks[MAX_EVICTED_CHUNKS];
+    u64              m_num_evictions;
+
+    // View distance of the landscape, and the one it is moving towards.
+    i32  m_view_distance;
+    i32  m_target_view_distance;
+    bool m_auto_view_distance;
+    // Moving average of the frame time, and number of frames since the view distance last changed.
+    f32  m_average_frame_time_ms;
+    i32  m_frames_since_view_change;
+
+    // Edits of the chunks that left the landscape.
+    RegionStore                       m_region_store;
+    IOTaskManager                    *m_io_task_manager;
+    std::unique_ptr<FlushRegionsTask> m_flush_regions_task;
+
     void initialize_chunks();
-    void initialize_threads();
-    Vec3f get_chunk_origin(i32 cx, i32 cy, i32 cz);
-    ChunkNoise *fill_noise_map_for_chunk_column(f32 origin_x, f32 origin_z);
-    void do_chunk_generation_work(Chunk *chunk);
-    void run_worker_thread();
-    void stop_threads();
-    void pass_chunk_buffer_to_gpu(const VAOArray::Entry &entry, const std::vector<Vertex_PLN> &buf);
+    // Releases everything the chunk holds and gives its memory back.
+    void destroy_chunk(Chunk *chunk);
+    // Remeshes every chunk in view over the next frames.
+    void remesh_all_chunks();
+    i32 get_chunk_lod(const Chunk *chunk, Vec3f eye) const;
+    // Enough noise points for a column at full resolution, or for a bicubic lattice of any spacing.
+    constexpr static i32 MAX_NOISE_POINTS = (Chunk::NUM_BLOCKS_PER_AXIS + 3)*(Chunk::NUM_BLOCKS_PER_AXIS + 3);
+
+    struct NoiseSamplingError
+    {
+        i32 max_error;
+        i64 sum_error;
+        i64 num_heights;
+        i64 num_wrong_heights;
+        i64 num_full_points;
+        i64 num_sampled_points;
+        f64 full_ms;
+        f64 sampled_ms;
+    };
+
+    void invalidate_column_heightmaps();
+    // Compares the heights of the landscape columns between the given sampling and full resolution.
+    NoiseSamplingError measure_noise_sampling_error(NoiseSamplingSettings settings);
+    void evaluate_fbm(const f64 *xs, const f64 *ys, i32 count, f64 *fbm);
+    // Computes the noise of every column of blocks in the chunk column, returning the number of
+    // points where the noise was evaluated.
+    i32 sample_column_noise(i32 column_x, i32 column_z, NoiseSamplingSettings settings,
+                            f64 noise[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS]);
+    // Copies the heights of the column into the given array, computing them if they are not cached.
+    void get_column_heightmap(i32 column_x, i32 column_z,
+                              i32 heights[Chunk::NUM_BLOCKS_PER_AXIS][Chunk::NUM_BLOCKS_PER_AXIS]);
+    // Writes the blocks of the chunk at the given origin, it can be called from any thread.
+    void do_chunk_generation_work(Vec3f chunk_origin, TerrainMode mode,
+                                  BlockType blocks[Chunk::NUM_BLOCKS_PER_AXIS]
+                                                  [Chunk::NUM_BLOCKS_PER_AXIS]
+                                                  [Chunk::NUM_BLOCKS_PER_AXIS]);
+    // Copies the generated blocks into the chunk and queues the meshing of the chunk and its
+    // neighbors, unless the request was cancelled. The chunks mutex should be held by the caller.
+    void finish_chunk_generation(Chunk *chunk, RequestHandle request, const GeneratedBlocks &generated);
+    // Moves the center column one chunk along x or z, loading and unloading the columns around it.
+    void move_center(i32 step_x, i32 step_z, Vec3f eye);
+    // Adds the chunks of the column, taking them back from the evicted chunks when possible. The
+    // other chunks are empty and they are generated once they are in view.
+    // The chunks mutex should be held by the caller.
+    void load_column(i32 column_x, i32 column_z, Vec3f eye);
+    // Saves the edits of the chunks of the column and removes them from the landscape, keeping the
+    // generated ones among the evicted chunks. The chunks mutex should be held by the caller.
+    void unload_column(i32 column_x, i32 column_z);
+    // Keeps the chunk among the evicted chunks if it was generated, destroying the least recently
+    // evicted chunk if every slot is used. Otherwise the chunk is destroyed.
+    void evict_chunk(Chunk *chunk);
+    // Distances are measured between the centers of the columns, so the columns within a distance
+    // of the center column form a disc around it.
+    bool is_column_within(i32 column_x, i32 column_z, i32 distance) const;
+    bool is_column_in_view(i32 column_x, i32 column_z) const;
+    // Loads the columns that entered the view distance and unloads the ones beyond the unload margin.
+    // Generates or meshes the chunks that entered the view distance and hides the ones that left it,
+    // remeshing the chunks next to them. The chunks mutex should be held by the caller.
+    void refresh_chunks_in_view(Vec3f eye);
+    // The chunks mutex should be held by the caller.
+    void queue_chunk_and_neighbors_meshing(Chunk *chunk);
+    // Generates the blocks of the chunk at the given origin and applies the edits saved for it.
+    // It can be called from any thread.
+    void load_or_generate_chunk(Vec3f chunk_origin, GeneratedBlocks &generated);
+    // Saves the edits of the chunk to disk if they changed. The chunks mutex should be held by the caller.
+    void save_chunk_if_dirty(Chunk *chunk);
+    // True when the chunk is known to have an empty mesh without meshing it, which happens for
+    // chunks of air and for solid chunks that are completely covered by their neighbors.
+    // The chunks mutex should be held by the caller, unless it is the main thread.
+    bool is_mesh_empty(const Chunk *chunk) const;
+    // Queues a meshing request for the chunk, unless it has no mesh and would not get one.
+    // The chunks mutex should be held by the caller, unless it is the main thread.
+    void queue_chunk_meshing(Chunk *chunk);
+    // Cancels the request of the chunk after the queue rejected it, so it is queued again later.
+    // The rejected request is given back to the pool.
+    void defer_request(Chunk *chunk, RequestHandle rejected);
+    // Queues again the requests that were deferred, as long as there is room in the queues.
+    // It should only be called from the main thread.
+    void retry_deferred_requests();
+    static void run_request_job(void *landscape);
+    // Generates or meshes the chunk of the first request of the queues, by priority.
+    void process_next_request();
+    // Waits for the jobs of the landscape, which do nothing from now on.
+    void stop_jobs();
+    // The vbo is allocated with space for capacity_quads quads, or just enough for the buffer if zero.
+    void pass_chunk_buffer_to_gpu(const VAOArray::Entry &entry, const ChunkVertexBuffer &buf,
+                                  i32 capacity_quads = 0);
     void remove_block(Vec3f raw_origin, Vec3f ray_direction);
+    EditableChunkMesh *acquire_editable_mesh(Chunk *chunk, const PaddedChunk &padded);
+    void release_editable_mesh(Chunk *chunk);
+    void upload_editable_mesh(Chunk *chunk);
 
     // Queues that contains the chunks that need to be loaded by the threads.
     // The queues are ordered by priority. The initial queue has more priority than the others.
@@ -226,9 +789,17 @@ private:
         QP_Low = 1,
         QP_Count = 2,
     };
+    // Adds the request to the queue and submits a job for it, returning false if the queue is full.
+    bool queue_request(QueuePriority priority, RequestHandle request);
+    RequestPool m_request_pool;
     ChunkQueue m_chunks_to_process_queues[QP_Count];
-    Semaphore  m_chunks_to_process_semaphore;
     ChunkQueue m_chunks_processed_queues[QP_Count];
+    // Chunks whose request was deferred, guarded by the deferred chunks mutex. A chunk is in the
+    // list while its is_request_deferred flag is set.
+    std::vector<Chunk*> m_deferred_chunks;
+    std::mutex          m_deferred_chunks_mutex;
+    // Deferred chunks taken out of the list by the main thread while it queues them again.
+    std::vector<Chunk*> m_retried_chunks;
 };
 
 #endif // __LANDSCAPE_HPP__
@@ -11,6 +11,7 @@
 #include "renderer.hpp"
 #include "camera.hpp"
 #include "io_task_manager.hpp"
+#include "job_system.hpp"
 #include "resource_manager.hpp"
 #include "skybox.hpp"
 #include "font.hpp"
@@ -31,8 +32,11 @@ struct DebugContext
     bool render_shadow_map;
     bool render_cascaded_frustum;
     bool render_wireframe;
+    // Meshing statistics of the last second, and the totals at its start.
+    Landscape::MeshingStats meshing_stats;
+    Landscape::MeshingStats meshing_stats_at_second_start;
 
-    void update(const Input &input, const Frustum &_frustum)
+    void update(const Input &input, const Frustum &_frustum, Landscape &landscape)
     {
         if (input.keys[GLFW_KEY_F5].was_pressed()) LT_Toggle(render_shadow_map);
         if (input.keys[GLFW_KEY_T].was_pressed()) LT_Toggle(render_wireframe);
@@ -41,6 +45,23 @@ struct DebugContext
             frustum = _frustum;
             LT_Toggle(render_cascaded_frustum);
         }
+        if (input.keys[GLFW_KEY_F7].was_pressed())
+        {
+            const i32 next_mode = (landscape.meshing_mode() + 1) % Landscape::MeshingMode_Count;
+            landscape.set_meshing_mode(static_cast<Landscape::MeshingMode>(next_mode));
+        }
+        if (input.keys[GLFW_KEY_F8].was_pressed()) landscape.debug_compare_meshing_modes();
+        if (input.keys[GLFW_KEY_F12].was_pressed())
+        {
+            const i32 next_downsampling = (landscape.lod_downsampling() + 1) % Landscape::LodDownsampling_Count;
+            landscape.set_lod_downsampling(static_cast<Landscape::LodDownsampling>(next_downsampling));
+        }
+        if (input.keys[GLFW_KEY_F9].was_pressed()) landscape.debug_measure_noise_sampling_error();
+        if (input.keys[GLFW_KEY_F10].was_pressed()) landscape.debug_benchmark_generation();
+        if (input.keys[GLFW_KEY_F3].was_pressed()) landscape.set_view_distance(landscape.view_distance() - 1);
+        if (input.keys[GLFW_KEY_F4].was_pressed()) landscape.set_view_distance(landscape.view_distance() + 1);
+        if (input.keys[GLFW_KEY_F11].was_pressed())
+            landscape.set_auto_view_distance(!landscape.auto_view_distance());
     }
 };
 
@@ -133,7 +154,7 @@ main_render_running(const Application &app, World &world,
 
         wireframe_shader->use();
         wireframe_shader->set_matrix("view", world.camera.frustum.view_matrix());
-        render_landscape(world);
+        render_landscape(world, wireframe_shader, true);
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
@@ -149,7 +170,8 @@ main_render_running(const Application &app, World &world,
             glDisable(GL_CULL_FACE);
             shadow_map.shader->use();
             shadow_map.shader->debug_validate();
-            render_landscape(world);
+            // NOTE: Every face direction is drawn, since culling is disabled for the shadow map.
+            render_landscape(world, shadow_map.shader, false);
             glEnable(GL_CULL_FACE);
         }
 
@@ -179,7 +201,7 @@ main_render_running(const Application &app, World &world,
             basic_shader->activate_and_bind_texture("texture_shadow_map", GL_TEXTURE_2D,
                                                     shadow_map.texture);
             basic_shader->debug_validate();
-            render_landscape(world);
+            render_landscape(world, basic_shader, true);
 
             if (g_debug_context.render_cascaded_frustum)
             {
@@ -204,11 +226,18 @@ main_render_running(const Application &app, World &world,
     world.crosshair.shader->use();
     render_mesh(world.crosshair.quad, world.crosshair.shader);
 
-    lt_local_persist char text_buffer[256] = {};
+    lt_local_persist const char *MESHING_MODE_NAMES[Landscape::MeshingMode_Count] = {"naive", "greedy", "binary"};
+    lt_local_persist const char *LOD_DOWNSAMPLING_NAMES[Landscape::LodDownsampling_Count] = {"any solid", "majority"};
+
+    lt_local_persist char text_buffer[1024] = {};
     snprintf(text_buffer, LT_Count(text_buffer),
              "FPS: %d, UPS: %d -- Frame time: %.2f min | %.2f max\n"
              "Camera: (%.2f, %.2f, %.2f) -- Front: (%.2f, %.2f, %.2f)\n"
-             "Sun: (%.2f, %.2f, %.2f) -- Dir: (%.2f, %.2f, %.2f)",
+             "Sun: (%.2f, %.2f, %.2f) -- Dir: (%.2f, %.2f, %.2f)\n"
+             "Meshing: %s (F7 to change, F8 to compare) -- Lod cells: %s (F12 to change)\n"
+             "Meshed chunks: %llu, %.3f allocations per chunk (last second)\n"
+             "Mesh cache: %.1f%% hits (last second), %.1f / %.1f MB\n"
+             "View distance: %d chunks%s (F3/F4 to change, F11 for automatic)",
              g_debug_context.fps,
              g_debug_context.ups,
              (f32)g_debug_context.min_frame_time,
@@ -224,7 +253,19 @@ main_render_running(const Application &app, World &world,
              world.sun.position.z,
              world.sun.direction.x,
              world.sun.direction.y,
-             world.sun.direction.z);
+             world.sun.direction.z,
+             MESHING_MODE_NAMES[world.landscape->meshing_mode()],
+             LOD_DOWNSAMPLING_NAMES[world.landscape->lod_downsampling()],
+             (unsigned long long)g_debug_context.meshing_stats.num_chunks_meshed,
+             (f64)g_debug_context.meshing_stats.num_allocations /
+                 std::max<u64>(g_debug_context.meshing_stats.num_chunks_meshed, 1),
+             100.0 * g_debug_context.meshing_stats.num_cache_hits /
+                 std::max<u64>(g_debug_context.meshing_stats.num_cache_hits +
+                               g_debug_context.meshing_stats.num_cache_misses, 1),
+             g_debug_context.meshing_stats.cache_used_bytes / (1024.0 * 1024.0),
+             g_debug_context.meshing_stats.cache_max_bytes / (1024.0 * 1024.0),
+             world.landscape->view_distance(),
+             world.landscape->auto_view_distance() ? " (automatic)" : "");
 
     render_text(font_atlas, text_buffer, 30.5f, 30.5f, font_shader);
 
@@ -273,7 +314,12 @@ main()
     //   2. Reduce number of polygons needed to render the world!! (is it worth it?)
     // --------------------------------------------------------------
     Application app("Deferred renderer", 1680, 1050);
-    IOTaskManager io_task_manager;
+
+    // NOTE: Zero worker threads means one for each core but the one of the main thread.
+    const i32 num_worker_threads = 0;
+    const bool pin_worker_threads = false;
+    JobSystem job_system(num_worker_threads, pin_worker_threads);
+    IOTaskManager io_task_manager(&job_system);
 
     ResourceManager resource_manager(&io_task_manager);
     {
@@ -395,6 +441,9 @@ main()
                 max_frame_time = std::chrono::duration_cast<milliseconds>(frame_time);
             if (frame_time < min_frame_time)
                 min_frame_time = std::chrono::duration_cast<milliseconds>(frame_time);
+
+            current_world.landscape->report_frame_time(
+                std::chrono::duration<f32, std::milli>(frame_time).count());
         }
 
         // Check if the window should close.
@@ -409,7 +458,7 @@ main()
             glfwPollEvents();
             app.process_input();
 
-            g_debug_context.update(app.input, world.camera.frustum);
+            g_debug_context.update(app.input, world.camera.frustum, *current_world.landscape);
 
             previous_world = current_world;
             current_world.update(app.input, shadow_map, basic_shader);
@@ -434,6 +483,20 @@ main()
             g_debug_context.max_frame_time = max_frame_time.count();
             g_debug_context.min_frame_time = min_frame_time.count();
 
+            const Landscape::MeshingStats meshing_stats = current_world.landscape->meshing_stats();
+            const Landscape::MeshingStats &previous_stats = g_debug_context.meshing_stats_at_second_start;
+            g_debug_context.meshing_stats.num_chunks_meshed =
+                meshing_stats.num_chunks_meshed - previous_stats.num_chunks_meshed;
+            g_debug_context.meshing_stats.num_allocations =
+                meshing_stats.num_allocations - previous_stats.num_allocations;
+            g_debug_context.meshing_stats.num_cache_hits =
+                meshing_stats.num_cache_hits - previous_stats.num_cache_hits;
+            g_debug_context.meshing_stats.num_cache_misses =
+                meshing_stats.num_cache_misses - previous_stats.num_cache_misses;
+            g_debug_context.meshing_stats.cache_used_bytes = meshing_stats.cache_used_bytes;
+            g_debug_context.meshing_stats.cache_max_bytes = meshing_stats.cache_max_bytes;
+            g_debug_context.meshing_stats_at_second_start = meshing_stats;
+
             max_frame_time = 0ms;
             min_frame_time = 10000ms;
             num_frames = 0;
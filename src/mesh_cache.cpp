@@ -0,0 +1,235 @@
+#include "mesh_cache.hpp"
+#include "chunk_mesher.hpp"
+#include <algorithm>
+#include <cstring>
+
+static_assert((MeshCache::MAX_ENTRIES & (MeshCache::MAX_ENTRIES - 1)) == 0,
+              "The number of entries should be a power of two.");
+
+MeshCache::MeshCache(usize max_bytes)
+    : num_hits(0)
+    , num_misses(0)
+    , m_entries(MAX_ENTRIES)
+    , m_slots(NUM_SLOTS, NO_ENTRY)
+    , m_max_bytes(max_bytes)
+    , m_used_bytes(0)
+{
+    clear();
+}
+
+usize
+MeshCache::buffer_size(const Entry &entry)
+{
+    return sizeof(Vertex_Chunk) * entry.vertices.capacity();
+}
+
+u32
+MeshCache::find_slot(PaddedChunkHash hash, i32 base_aby, i32 meshing_mode) const
+{
+    // NOTE: There are more slots than entries, so the probe always ends at an empty slot.
+    for (u32 slot = hash.hash & (NUM_SLOTS - 1);; slot = (slot + 1) & (NUM_SLOTS - 1))
+    {
+        const u32 index = m_slots[slot];
+        if (index == NO_ENTRY)
+            return slot;
+
+        // NOTE: The textures depend on the height of the chunk, so it is part of the key
+        // together with the meshing mode.
+        const Entry &entry = m_entries[index];
+        if (entry.hash.hash == hash.hash && entry.hash.check == hash.check &&
+            entry.base_aby == base_aby && entry.meshing_mode == meshing_mode)
+            return slot;
+    }
+}
+
+void
+MeshCache::remove_from_slots(u32 entry_index)
+{
+    const Entry &entry = m_entries[entry_index];
+    u32 slot = find_slot(entry.hash, entry.base_aby, entry.meshing_mode);
+    LT_Assert(m_slots[slot] == entry_index);
+
+    // NOTE: The entries probed after the removed one are moved back into the hole when their probe
+    // starts before it, otherwise a probe would stop at the hole before reaching them.
+    for (u32 next = (slot + 1) & (NUM_SLOTS - 1); m_slots[next] != NO_ENTRY; next = (next + 1) & (NUM_SLOTS - 1))
+    {
+        const u32 home = m_entries[m_slots[next]].hash.hash & (NUM_SLOTS - 1);
+        if (((next - home) & (NUM_SLOTS - 1)) >= ((next - slot) & (NUM_SLOTS - 1)))
+        {
+            m_slots[slot] = m_slots[next];
+            slot = next;
+        }
+    }
+    m_slots[slot] = NO_ENTRY;
+}
+
+void
+MeshCache::link_front(u32 entry_index)
+{
+    Entry &entry = m_entries[entry_index];
+    entry.previous = NO_ENTRY;
+    entry.next = m_first_used;
+    if (m_first_used != NO_ENTRY)
+        m_entries[m_first_used].previous = entry_index;
+    else
+        m_last_used = entry_index;
+    m_first_used = entry_index;
+}
+
+void
+MeshCache::unlink(u32 entry_index)
+{
+    const Entry &entry = m_entries[entry_index];
+    if (entry.previous != NO_ENTRY)
+        m_entries[entry.previous].next = entry.next;
+    else
+        m_first_used = entry.next;
+
+    if (entry.next != NO_ENTRY)
+        m_entries[entry.next].previous = entry.previous;
+    else
+        m_last_used = entry.previous;
+}
+
+u32
+MeshCache::evict_last()
+{
+    const u32 entry_index = m_last_used;
+    LT_Assert(entry_index != NO_ENTRY);
+    remove_from_slots(entry_index);
+    unlink(entry_index);
+    return entry_index;
+}
+
+bool
+MeshCache::find(PaddedChunkHash hash, const PaddedChunk &padded, i32 meshing_mode, ChunkVertexBuffer &vertices)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+
+    const u32 entry_index = m_slots[find_slot(hash, padded.base_aby, meshing_mode)];
+    if (entry_index == NO_ENTRY)
+    {
+        num_misses++;
+        return false;
+    }
+
+    // Move the entry to the front, since it was the last one used.
+    unlink(entry_index);
+    link_front(entry_index);
+
+    const Entry &entry = m_entries[entry_index];
+    vertices.assign(entry.vertices.begin(), entry.vertices.end());
+    num_hits++;
+    return true;
+}
+
+void
+MeshCache::insert(PaddedChunkHash hash, const PaddedChunk &padded, i32 meshing_mode, const ChunkVertexBuffer &vertices)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+
+    // NOTE: Another thread may have meshed the same chunk in the meantime.
+    const u32 existing_index = m_slots[find_slot(hash, padded.base_aby, meshing_mode)];
+    if (existing_index != NO_ENTRY)
+    {
+        unlink(existing_index);
+        link_front(existing_index);
+        return;
+    }
+
+    const usize size = sizeof(Vertex_Chunk) * vertices.size();
+    const usize fixed_size = sizeof(Entry)*MAX_ENTRIES + sizeof(u32)*NUM_SLOTS;
+    if (fixed_size + size > m_max_bytes)
+        return;
+
+    // The new mesh takes a free entry, or the least recently used one along with its buffer.
+    u32 entry_index;
+    if (m_first_free != NO_ENTRY)
+    {
+        entry_index = m_first_free;
+        m_first_free = m_entries[entry_index].next;
+    }
+    else
+    {
+        entry_index = evict_last();
+    }
+    Entry &entry = m_entries[entry_index];
+
+    // Evict the least recently used meshes until the new one fits, freeing their buffers.
+    while (m_used_bytes - buffer_size(entry) + std::max(buffer_size(entry), size) > m_max_bytes)
+    {
+        if (m_last_used == NO_ENTRY)
+        {
+            // NOTE: Only the buffer of the entry itself is left, and it is too big.
+            m_used_bytes -= buffer_size(entry);
+            ChunkVertexBuffer().swap(entry.vertices);
+            break;
+        }
+
+        const u32 last_index = evict_last();
+        Entry &last = m_entries[last_index];
+        m_used_bytes -= buffer_size(last);
+        ChunkVertexBuffer().swap(last.vertices);
+        last.next = m_first_free;
+        m_first_free = last_index;
+    }
+
+    m_used_bytes -= buffer_size(entry);
+    entry.vertices.assign(vertices.begin(), vertices.end());
+    m_used_bytes += buffer_size(entry);
+
+    entry.hash = hash;
+    entry.base_aby = padded.base_aby;
+    entry.meshing_mode = meshing_mode;
+    link_front(entry_index);
+    // NOTE: The slot is looked for again, since evicting entries moves the others around.
+    m_slots[find_slot(hash, padded.base_aby, meshing_mode)] = entry_index;
+}
+
+void
+MeshCache::clear()
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+
+    for (u32 i = 0; i < MAX_ENTRIES; i++)
+    {
+        ChunkVertexBuffer().swap(m_entries[i].vertices);
+        m_entries[i].next = (i + 1 < MAX_ENTRIES) ? i + 1 : NO_ENTRY;
+    }
+    m_first_free = 0;
+    m_first_used = NO_ENTRY;
+    m_last_used = NO_ENTRY;
+    std::fill(m_slots.begin(), m_slots.end(), NO_ENTRY);
+    m_used_bytes = sizeof(Entry)*MAX_ENTRIES + sizeof(u32)*NUM_SLOTS;
+}
+
+PaddedChunkHash
+hash_padded_chunk(const PaddedChunk &padded)
+{
+    // NOTE: Two 64 bit multiply and rotate hashes over the blocks, read 8 bytes at a time, with
+    // different constants so a collision of one of them is not a collision of the other one.
+    // The occupancy masks are not hashed, since they only depend on the blocks.
+    static_assert(sizeof(padded.blocks) % sizeof(u64) == 0, "blocks should be hashed in 8 byte words");
+
+    const u8 *bytes = &padded.blocks[0][0][0];
+    const usize num_words = sizeof(padded.blocks) / sizeof(u64);
+
+    u64 hash = 0x9E3779B97F4A7C15ull;
+    u64 check = 0xD6E8FEB86659FD93ull;
+    for (usize i = 0; i < num_words; i++)
+    {
+        u64 word;
+        std::memcpy(&word, bytes + i*sizeof(u64), sizeof(u64));
+        hash ^= word * 0xBF58476D1CE4E5B9ull;
+        hash = (hash << 31) | (hash >> 33);
+        hash *= 0x94D049BB133111EBull;
+        check ^= word * 0xFF51AFD7ED558CCDull;
+        check = (check << 27) | (check >> 37);
+        check *= 0xC4CEB9FE1A85EC53ull;
+    }
+
+    PaddedChunkHash result;
+    result.hash = hash ^ (hash >> 29);
+    result.check = check ^ (check >> 33);
+    return result;
+}
@@ -0,0 +1,87 @@
+#ifndef __MESH_CACHE_HPP__
+#define __MESH_CACHE_HPP__
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "lt_core.hpp"
+#include "vertex.hpp"
+
+struct PaddedChunk;
+
+// Two independent hashes of the blocks of a padded chunk. The first one finds the entry of the
+// cache, the second one tells apart padded chunks whose first hash collides.
+struct PaddedChunkHash
+{
+    u64 hash;
+    u64 check;
+};
+
+//
+// Cache of chunk meshes keyed by the contents of the padded chunk they were built from.
+// Since vertex positions are relative to the chunk origin, chunks with the same blocks and
+// borders share a mesh regardless of where they are, e.g. empty sky chunks or buried chunks.
+//
+// The entries and their index are allocated once. An entry that is replaced keeps its vertex
+// buffer, so a new mesh that is not bigger than the one it replaces does not allocate.
+//
+struct MeshCache
+{
+    constexpr static i32 MAX_ENTRIES = 4096;
+
+    MeshCache(usize max_bytes);
+
+    // Copies the cached mesh to vertices and returns true if there is a mesh for the padded chunk.
+    bool find(PaddedChunkHash hash, const PaddedChunk &padded, i32 meshing_mode, ChunkVertexBuffer &vertices);
+    void insert(PaddedChunkHash hash, const PaddedChunk &padded, i32 meshing_mode, const ChunkVertexBuffer &vertices);
+    void clear();
+
+    inline usize max_bytes() const { return m_max_bytes; }
+    inline usize used_bytes() const { return m_used_bytes; }
+
+public:
+    std::atomic<u64> num_hits;
+    std::atomic<u64> num_misses;
+
+private:
+    constexpr static u32 NO_ENTRY = 0xFFFFFFFF;
+    // Twice as many slots as entries, so the probes stay short.
+    constexpr static u32 NUM_SLOTS = 2*MAX_ENTRIES;
+
+    struct Entry
+    {
+        PaddedChunkHash hash;
+        i32 base_aby;
+        i32 meshing_mode;
+        // Neighbors in the list of used entries, ordered from the most to the least recently
+        // used, or the next free entry while the entry is free.
+        u32 previous;
+        u32 next;
+        ChunkVertexBuffer vertices;
+    };
+
+    // Returns the slot of the index holding the entry, or the empty slot where it would go.
+    u32 find_slot(PaddedChunkHash hash, i32 base_aby, i32 meshing_mode) const;
+    void remove_from_slots(u32 entry_index);
+    void link_front(u32 entry_index);
+    void unlink(u32 entry_index);
+    // Removes the least recently used entry from the cache, returning its index.
+    u32 evict_last();
+    static usize buffer_size(const Entry &entry);
+
+    std::vector<Entry> m_entries;
+    // Open addressing index of the used entries, with linear probing on the first hash.
+    std::vector<u32> m_slots;
+    u32 m_first_used;
+    u32 m_last_used;
+    u32 m_first_free;
+    std::mutex m_mutex;
+    const usize m_max_bytes;
+    // Atomic since it is also read without the lock for statistics. The entries and the index
+    // are part of it, as well as the capacity of every vertex buffer.
+    std::atomic<usize> m_used_bytes;
+};
+
+PaddedChunkHash hash_padded_chunk(const PaddedChunk &padded);
+
+#endif // __MESH_CACHE_HPP__
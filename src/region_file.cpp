@@ -0,0 +1,802 @@
+#include "region_file.hpp"
+#include "lt_utils.hpp"
+#include "world_coordinates.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+lt_global_variable lt::Logger logger("region_file");
+
+// NOTE: Files are written with the byte order of the machine, which is assumed to be little endian.
+lt_global_variable const u32 REGION_MAGIC = 0x47525856; // "VXRG"
+// Version 1 stored whole chunks, version 2 stored edits, and version 3 flags the whole chunks
+// left in files converted from version 1.
+lt_global_variable const u32 REGION_VERSION = 3;
+lt_global_variable const usize REGION_TABLE_OFFSET = 2*sizeof(u32);
+lt_global_variable const u32 FULL_CHUNK_FLAG = 0x80000000;
+// Region files are only compacted when they would shrink by at least this much.
+lt_global_variable const usize MIN_UNUSED_BYTES_TO_COMPACT = 64*1024;
+
+lt_internal void
+write_varint(std::vector<u8> &payload, u32 value)
+{
+    while (value >= 0x80)
+    {
+        payload.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    payload.push_back(value);
+}
+
+lt_internal bool
+read_varint(const u8 *payload, usize size, usize &position, u32 &value)
+{
+    value = 0;
+    for (i32 shift = 0; shift < 32 && position < size; shift += 7)
+    {
+        const u8 byte = payload[position++];
+        value |= (u32)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Run length encoded blocks of version 1 files, as pairs of block type and run length minus one
+// in [x][y][z] order.
+lt_internal bool
+decompress_blocks(const u8 *payload, usize size, BlockType *blocks)
+{
+    i32 num_blocks = 0;
+    for (usize i = 0; i + 1 < size; i += 2)
+    {
+        const i32 run_length = payload[i+1] + 1;
+        if (payload[i] >= BlockType_Count || num_blocks + run_length > BlockStorage::NUM_BLOCKS)
+            return false;
+
+        std::fill(blocks + num_blocks, blocks + num_blocks + run_length, static_cast<BlockType>(payload[i]));
+        num_blocks += run_length;
+    }
+    return num_blocks == BlockStorage::NUM_BLOCKS;
+}
+
+lt_internal bool
+write_all(int fd, const u8 *data, usize size, usize offset)
+{
+    while (size > 0)
+    {
+        const ssize_t written = pwrite(fd, data, size, offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+lt_internal i32
+region_chunk_index(i32 local_x, i32 cy, i32 local_z)
+{
+    LT_Assert(cy >= 0 && cy < RegionStore::MAX_CHUNKS_Y);
+    return (local_x*RegionStore::REGION_SIZE + local_z)*RegionStore::MAX_CHUNKS_Y + cy;
+}
+
+RegionStore::RegionStore(const std::string &directory, i32 max_columns_per_axis)
+    : m_directory(directory)
+    , m_num_region_uses(0)
+    , m_has_failed_chunks(false)
+{
+    // NOTE: Every directory of the path is created, the ones that already exist are left as they are.
+    for (usize i = 1; i <= directory.size(); i++)
+    {
+        if (i < directory.size() && directory[i] != '/')
+            continue;
+
+        const std::string path = directory.substr(0, i);
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+            logger.error("Cannot create directory ", path, ": ", strerror(errno));
+    }
+
+    // NOTE: The columns of an axis span at most max_columns_per_axis / REGION_SIZE + 2 regions
+    // when they do not line up with them. The ring around them keeps the slots of the regions
+    // being left behind, which are still flushed, from taking the slots of the regions in view.
+    const i32 regions_per_axis = max_columns_per_axis / REGION_SIZE + 2 + 2;
+    m_num_regions = regions_per_axis*regions_per_axis;
+    m_regions = std::make_unique<Region[]>(m_num_regions);
+
+    for (i32 i = 0; i < m_num_regions; i++)
+    {
+        Region &region = m_regions[i];
+        region.is_assigned = false;
+        region.num_users = 0;
+        region.last_used = 0;
+        region.is_open = false;
+        region.fd = -1;
+        region.is_writable = false;
+        region.mapping = nullptr;
+        region.mapped_size = 0;
+        region.file_size = 0;
+    }
+
+    logger.log("Regions path: ", m_directory);
+}
+
+RegionStore::~RegionStore()
+{
+    if (has_pending_chunks())
+        logger.error("Region store destroyed with chunks that were not written.");
+
+    for (i32 i = 0; i < m_num_regions; i++)
+        close_region(m_regions[i]);
+}
+
+void
+RegionStore::save_chunk(i32 column_x, i32 cy, i32 column_z, const ChunkEditLog &edits)
+{
+    if (cy < 0 || cy >= MAX_CHUNKS_Y)
+    {
+        logger.error("Chunk ", cy, " of column (", column_x, ", ", column_z, ") cannot be saved.");
+        return;
+    }
+
+    // NOTE: The edits are encoded before taking the lock, which keeps loads from waiting on it.
+    std::vector<u8> payload;
+    edits.encode(payload);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending_chunks[ChunkKey{column_x, cy, column_z}] = std::move(payload);
+}
+
+bool
+RegionStore::load_chunk(i32 column_x, i32 cy, i32 column_z,
+                        const BlockType generated[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                                 [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                                 [BlockStorage::NUM_BLOCKS_PER_AXIS],
+                        ChunkEditLog &edits)
+{
+    if (cy < 0 || cy >= MAX_CHUNKS_Y)
+        return false;
+
+    const ChunkKey key = {column_x, cy, column_z};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // NOTE: A chunk that left the landscape and came back before being written is still in memory.
+        auto it = m_pending_chunks.find(key);
+        if (it != m_pending_chunks.end())
+            return edits.decode(it->second.data(), it->second.size());
+
+        it = m_flushing_chunks.find(key);
+        if (it != m_flushing_chunks.end())
+            return edits.decode(it->second.data(), it->second.size());
+    }
+
+    const i32 region_x = floor_div(column_x, REGION_SIZE);
+    const i32 region_z = floor_div(column_z, REGION_SIZE);
+    Region &region = lock_region(region_x, region_z, false);
+
+    const i32 index = region_chunk_index(column_x - region_x*REGION_SIZE, cy, column_z - region_z*REGION_SIZE);
+    const TableEntry entry = region.table[index];
+    const u32 size = entry.size & ~FULL_CHUNK_FLAG;
+
+    bool is_loaded = false;
+    if (size > 0)
+    {
+        if (region.mapping && (usize)entry.offset + size <= region.mapped_size)
+        {
+            if (entry.size & FULL_CHUNK_FLAG)
+            {
+                BlockType blocks[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                [BlockStorage::NUM_BLOCKS_PER_AXIS];
+                is_loaded = decompress_blocks(region.mapping + entry.offset, size, &blocks[0][0][0]);
+                if (is_loaded)
+                    edits.diff(generated, blocks);
+            }
+            else
+            {
+                is_loaded = edits.decode(region.mapping + entry.offset, size);
+            }
+        }
+
+        if (!is_loaded)
+        {
+            logger.error("Corrupted chunk ", cy, " of column (", column_x, ", ", column_z, ") in ",
+                         region_path(region_x, region_z));
+        }
+    }
+
+    unlock_region(region, false);
+    return is_loaded;
+}
+
+void
+RegionStore::flush()
+{
+    std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+
+    // NOTE: The chunks are moved aside while they are written, so the lock is not held during the
+    // writes, and loads keep finding them until they are in their region file.
+    std::vector<std::pair<ChunkKey, const std::vector<u8>*>> chunks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        LT_Assert(m_flushing_chunks.empty());
+        m_flushing_chunks.swap(m_pending_chunks);
+        chunks.reserve(m_flushing_chunks.size());
+        for (const auto &it : m_flushing_chunks)
+            chunks.push_back(std::make_pair(it.first, &it.second));
+    }
+
+    auto region_of = [](const ChunkKey &key) {
+        return std::make_pair(floor_div(key.column_x, REGION_SIZE), floor_div(key.column_z, REGION_SIZE));
+    };
+    std::sort(chunks.begin(), chunks.end(), [&](const auto &a, const auto &b) {
+        return region_of(a.first) < region_of(b.first);
+    });
+
+    bool has_failed_chunks = false;
+
+    // PERFORMANCE: The chunks of a region are written under a single lock of the region, and the
+    // file is mapped again once, after all of them were written.
+    for (usize first = 0; first < chunks.size();)
+    {
+        const auto region_coords = region_of(chunks[first].first);
+        usize last = first;
+        while (last < chunks.size() && region_of(chunks[last].first) == region_coords)
+            last++;
+
+        // NOTE: The payload pointers are cleared for the chunks that were written.
+        Region &region = lock_region(region_coords.first, region_coords.second, true);
+        for (usize i = first; i < last; i++)
+        {
+            const ChunkKey &key = chunks[i].first;
+            if (write_chunk(region, key, *chunks[i].second))
+                chunks[i].second = nullptr;
+            else
+                logger.error("Failed to write chunk ", key.cy, " of column (", key.column_x, ", ", key.column_z, ")");
+        }
+        if (region.fd >= 0 && map_region(region))
+            compact_region(region);
+        unlock_region(region, true);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (usize i = first; i < last; i++)
+            {
+                auto it = m_flushing_chunks.find(chunks[i].first);
+                // NOTE: A chunk that failed is written by the next flush, unless it was saved again
+                // in the meantime, since the newer edits replace the ones that failed.
+                if (chunks[i].second)
+                {
+                    has_failed_chunks = true;
+                    m_pending_chunks.emplace(it->first, std::move(it->second));
+                }
+                m_flushing_chunks.erase(it);
+            }
+        }
+        first = last;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_has_failed_chunks = has_failed_chunks;
+    if (has_failed_chunks)
+        m_last_failure = std::chrono::steady_clock::now();
+}
+
+bool
+RegionStore::has_pending_chunks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_pending_chunks.empty() || !m_flushing_chunks.empty();
+}
+
+bool
+RegionStore::should_flush() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending_chunks.empty())
+        return false;
+    return !m_has_failed_chunks || std::chrono::steady_clock::now() - m_last_failure >= FLUSH_RETRY_DELAY;
+}
+
+std::string
+RegionStore::region_path(i32 region_x, i32 region_z) const
+{
+    return m_directory + "/r." + std::to_string(region_x) + "." + std::to_string(region_z) + ".region";
+}
+
+RegionStore::Region &
+RegionStore::lock_region(i32 region_x, i32 region_z, bool exclusive)
+{
+    Region *region = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            for (i32 i = 0; i < m_num_regions; i++)
+            {
+                Region &slot = m_regions[i];
+                if (slot.is_assigned && slot.region_x == region_x && slot.region_z == region_z)
+                {
+                    region = &slot;
+                    break;
+                }
+            }
+            if (region)
+                break;
+
+            // The least recently used slot that nobody uses is given to the region.
+            for (i32 i = 0; i < m_num_regions; i++)
+            {
+                Region &slot = m_regions[i];
+                if (slot.num_users == 0 && (!region || slot.last_used < region->last_used))
+                    region = &slot;
+            }
+            if (region)
+            {
+                region->region_x = region_x;
+                region->region_z = region_z;
+                region->is_assigned = true;
+                break;
+            }
+
+            // NOTE: Users only keep a slot for reading one chunk or writing the chunks of a flush.
+            m_region_released.wait(lock);
+        }
+
+        region->num_users++;
+        region->last_used = ++m_num_region_uses;
+    }
+
+    // NOTE: The slot cannot be given to another region while it is used, so once the file of the
+    // region is open it stays open until the slot is unlocked.
+    auto is_open = [&]() {
+        return region->is_open && region->open_region_x == region_x && region->open_region_z == region_z;
+    };
+
+    if (exclusive)
+    {
+        region->mutex.lock();
+        if (!is_open())
+            open_region(*region, region_x, region_z);
+        return *region;
+    }
+
+    region->mutex.lock_shared();
+    if (is_open())
+        return *region;
+    region->mutex.unlock_shared();
+
+    {
+        std::lock_guard<std::shared_mutex> lock(region->mutex);
+        if (!is_open())
+            open_region(*region, region_x, region_z);
+    }
+    region->mutex.lock_shared();
+    return *region;
+}
+
+void
+RegionStore::unlock_region(Region &region, bool exclusive)
+{
+    if (exclusive)
+        region.mutex.unlock();
+    else
+        region.mutex.unlock_shared();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    LT_Assert(region.num_users > 0);
+    if (--region.num_users == 0)
+        m_region_released.notify_one();
+}
+
+void
+RegionStore::open_region(Region &region, i32 region_x, i32 region_z)
+{
+    close_region(region);
+
+    region.open_region_x = region_x;
+    region.open_region_z = region_z;
+    region.version = REGION_VERSION;
+
+    const std::string path = region_path(region_x, region_z);
+    const int fd = open(path.c_str(), O_RDWR);
+    if (fd < 0)
+    {
+        // NOTE: Only a region whose file does not exist is created when a chunk is written. Any other
+        // error may go away, e.g. when the process ran out of file descriptors, so the region is left
+        // closed and its file is opened again the next time it is used.
+        if (errno != ENOENT)
+        {
+            logger.error("Cannot open ", path, ": ", strerror(errno));
+            return;
+        }
+        region.is_open = true;
+        region.is_writable = true;
+        return;
+    }
+
+    region.is_open = true;
+
+    struct stat file_stat;
+    u32 header[2] = {};
+    const bool has_header = fstat(fd, &file_stat) == 0 && pread(fd, header, sizeof(header), 0) == sizeof(header);
+    if (has_header && header[0] == REGION_MAGIC && header[1] > REGION_VERSION)
+    {
+        // NOTE: The chunks of the region are neither read nor written, and they stay pending
+        // until the program stops.
+        logger.error("Region file ", path, " has version ", header[1], ", which is newer than version ",
+                     REGION_VERSION, ". Its chunks will not be saved.");
+        close(fd);
+        return;
+    }
+
+    if (!has_header || (usize)file_stat.st_size < REGION_TABLE_OFFSET + sizeof(region.table) ||
+        header[0] != REGION_MAGIC || header[1] == 0)
+    {
+        // NOTE: The invalid file is moved aside instead of being overwritten, so whatever it holds
+        // can still be recovered. The region only starts a new file once the old one is out of the way.
+        close(fd);
+        std::string bad_path = path + ".bad";
+        for (i32 i = 1; access(bad_path.c_str(), F_OK) == 0; i++)
+            bad_path = path + ".bad" + std::to_string(i);
+        if (rename(path.c_str(), bad_path.c_str()) != 0)
+        {
+            logger.error("Invalid region file ", path, " cannot be moved aside: ", strerror(errno),
+                         ". Its chunks will not be saved.");
+            return;
+        }
+        logger.error("Moved invalid region file ", path, " to ", bad_path);
+        region.is_writable = true;
+        return;
+    }
+
+    region.fd = fd;
+    region.is_writable = true;
+    region.version = header[1];
+    region.file_size = file_stat.st_size;
+
+    if (!map_region(region))
+    {
+        close_region(region);
+        return;
+    }
+    std::memcpy(region.table, region.mapping + REGION_TABLE_OFFSET, sizeof(region.table));
+
+    // NOTE: Every chunk of a version 1 file is a whole chunk. The flag may already be set if the
+    // file was being converted when the program stopped.
+    if (region.version == 1)
+    {
+        for (auto &entry : region.table)
+            if (entry.size > 0) entry.size |= FULL_CHUNK_FLAG;
+    }
+
+    // NOTE: Files are also compacted when they are opened, for the edits left behind by the flushes
+    // of a previous run that stopped before compacting them.
+    compact_region(region);
+}
+
+void
+RegionStore::close_region(Region &region)
+{
+    if (region.mapping)
+        munmap(region.mapping, region.mapped_size);
+    if (region.fd >= 0)
+        close(region.fd);
+
+    region.is_open = false;
+    region.fd = -1;
+    region.is_writable = false;
+    region.mapping = nullptr;
+    region.mapped_size = 0;
+    region.file_size = 0;
+    std::memset(region.table, 0, sizeof(region.table));
+}
+
+bool
+RegionStore::map_region(Region &region)
+{
+    if (region.file_size <= region.mapped_size)
+        return true;
+
+    LT_Assert(region.fd >= 0);
+
+    // NOTE: The file grows as chunks are written, so the whole file is mapped again.
+    if (region.mapping)
+        munmap(region.mapping, region.mapped_size);
+
+    void *mapping = mmap(nullptr, region.file_size, PROT_READ, MAP_SHARED, region.fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        logger.error("Cannot map ", region_path(region.open_region_x, region.open_region_z), ": ", strerror(errno));
+        region.mapping = nullptr;
+        region.mapped_size = 0;
+        return false;
+    }
+
+    region.mapping = static_cast<u8*>(mapping);
+    region.mapped_size = region.file_size;
+    return true;
+}
+
+bool
+RegionStore::write_chunk(Region &region, const ChunkKey &key, const std::vector<u8> &payload)
+{
+    LT_Assert(!payload.empty());
+
+    const std::string path = region_path(region.open_region_x, region.open_region_z);
+
+    if (!region.is_open || !region.is_writable)
+        return false;
+
+    if (region.fd < 0)
+    {
+        // NOTE: The file did not exist when the region was opened. It is never truncated, so a file
+        // that appeared in the meantime is left alone and the chunks are written the next time.
+        region.fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (region.fd < 0)
+        {
+            logger.error("Cannot create ", path, ": ", strerror(errno));
+            close_region(region);
+            return false;
+        }
+
+        const u32 header[2] = {REGION_MAGIC, REGION_VERSION};
+        std::memset(region.table, 0, sizeof(region.table));
+        if (pwrite(region.fd, header, sizeof(header), 0) != sizeof(header) ||
+            pwrite(region.fd, region.table, sizeof(region.table), REGION_TABLE_OFFSET) != sizeof(region.table))
+        {
+            // NOTE: The file was created here and holds nothing yet, so it is removed instead of
+            // being left behind as an invalid file.
+            logger.error("Cannot write the header of ", path, ": ", strerror(errno));
+            unlink(path.c_str());
+            close_region(region);
+            return false;
+        }
+        region.version = REGION_VERSION;
+        region.file_size = REGION_TABLE_OFFSET + sizeof(region.table);
+    }
+    else if (region.version != REGION_VERSION)
+    {
+        // NOTE: The table is written before the version. A version 1 file whose table already has
+        // the flags is read the same way, so the file is valid at every step.
+        const u32 version = REGION_VERSION;
+        if (pwrite(region.fd, region.table, sizeof(region.table), REGION_TABLE_OFFSET) != sizeof(region.table) ||
+            pwrite(region.fd, &version, sizeof(version), sizeof(u32)) != sizeof(version))
+        {
+            logger.error("Cannot convert ", path, " to version ", REGION_VERSION, ": ", strerror(errno));
+            return false;
+        }
+        logger.log("Converted ", path, " from version ", region.version, " to version ", REGION_VERSION);
+        region.version = REGION_VERSION;
+    }
+
+    const i32 index = region_chunk_index(key.column_x - region.open_region_x*REGION_SIZE, key.cy,
+                                         key.column_z - region.open_region_z*REGION_SIZE);
+    TableEntry entry = region.table[index];
+
+    // NOTE: The edits are always appended to the end of the file, never written over the old edits
+    // of the chunk. If the program stops before the table entry is written, the entry still points
+    // to the old edits, which are left untouched. The old edits are dropped by compact_region.
+    entry.offset = region.file_size;
+    entry.size = payload.size();
+
+    if (pwrite(region.fd, payload.data(), payload.size(), entry.offset) != (ssize_t)payload.size())
+        return false;
+
+    // NOTE: The table entry is only written after the edits, so the file never points to edits
+    // that are not there.
+    if (pwrite(region.fd, &entry, sizeof(entry), REGION_TABLE_OFFSET + index*sizeof(TableEntry)) != sizeof(entry))
+        return false;
+
+    region.table[index] = entry;
+    region.file_size = entry.offset + entry.size;
+    return true;
+}
+
+void
+RegionStore::compact_region(Region &region)
+{
+    LT_Assert(region.fd >= 0);
+    LT_Assert(region.mapping && region.mapped_size >= region.file_size);
+
+    const usize data_offset = REGION_TABLE_OFFSET + sizeof(region.table);
+    usize used_size = 0;
+    for (const auto &entry : region.table)
+        used_size += entry.size & ~FULL_CHUNK_FLAG;
+
+    // PERFORMANCE: The file is rewritten once the unused edits take as much room as the used ones,
+    // so the edits are copied a bounded number of times on average, however often they are saved.
+    const usize unused_size = (region.file_size > data_offset + used_size)
+        ? region.file_size - data_offset - used_size
+        : 0;
+    if (!region.is_writable || unused_size < MIN_UNUSED_BYTES_TO_COMPACT || unused_size < used_size)
+        return;
+
+    const std::string path = region_path(region.open_region_x, region.open_region_z);
+
+    // NOTE: Whole chunks of version 1 files keep their flag, which is what version 3 files use, so
+    // the compacted file is always written with the current version.
+    std::vector<u8> contents(data_offset + used_size);
+    const u32 header[2] = {REGION_MAGIC, REGION_VERSION};
+    std::memcpy(contents.data(), header, sizeof(header));
+
+    TableEntry table[NUM_REGION_CHUNKS];
+    usize offset = data_offset;
+    for (i32 i = 0; i < NUM_REGION_CHUNKS; i++)
+    {
+        const TableEntry &entry = region.table[i];
+        const u32 size = entry.size & ~FULL_CHUNK_FLAG;
+        table[i] = TableEntry{0, 0};
+        if (size == 0)
+            continue;
+
+        // NOTE: An entry that points outside of the file could not be loaded anyway.
+        if ((usize)entry.offset + size > region.file_size)
+        {
+            logger.error("Dropping corrupted chunk ", i, " of ", path, " while compacting it");
+            continue;
+        }
+
+        std::memcpy(contents.data() + offset, region.mapping + entry.offset, size);
+        table[i] = TableEntry{(u32)offset, entry.size};
+        offset += size;
+    }
+    contents.resize(offset);
+    std::memcpy(contents.data() + REGION_TABLE_OFFSET, table, sizeof(table));
+
+    // NOTE: The compacted file is written next to the old one and only replaces it once it is on
+    // disk, so the region is never left without a valid file.
+    const std::string temporary_path = path + ".tmp";
+    const int fd = open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        logger.error("Cannot create ", temporary_path, ": ", strerror(errno));
+        return;
+    }
+    if (!write_all(fd, contents.data(), contents.size(), 0) || fsync(fd) != 0 ||
+        rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        logger.error("Cannot compact ", path, ": ", strerror(errno));
+        close(fd);
+        unlink(temporary_path.c_str());
+        return;
+    }
+
+    logger.log("Compacted ", path, " from ", region.file_size, " to ", contents.size(), " bytes");
+
+    munmap(region.mapping, region.mapped_size);
+    close(region.fd);
+    region.fd = fd;
+    region.mapping = nullptr;
+    region.mapped_size = 0;
+    region.file_size = contents.size();
+    region.version = REGION_VERSION;
+    std::memcpy(region.table, table, sizeof(table));
+
+    if (!map_region(region))
+        close_region(region);
+}
+
+// ----------------------------------------------------------------------------------------------
+// ChunkEditLog
+// ----------------------------------------------------------------------------------------------
+
+void
+ChunkEditLog::record(i32 x, i32 y, i32 z, BlockType type)
+{
+    constexpr i32 N = BlockStorage::NUM_BLOCKS_PER_AXIS;
+    LT_Assert(x >= 0 && x < N && y >= 0 && y < N && z >= 0 && z < N);
+
+    const u16 index = (x*N + y)*N + z;
+    auto it = std::lower_bound(edits.begin(), edits.end(), index, [](const BlockEdit &edit, u16 index) {
+        return edit.index < index;
+    });
+
+    if (it != edits.end() && it->index == index)
+        it->type = type;
+    else
+        edits.insert(it, BlockEdit{index, type});
+}
+
+void
+ChunkEditLog::apply(BlockType blocks[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                    [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                    [BlockStorage::NUM_BLOCKS_PER_AXIS]) const
+{
+    BlockType *flat_blocks = &blocks[0][0][0];
+    for (const auto &edit : edits)
+        flat_blocks[edit.index] = edit.type;
+}
+
+void
+ChunkEditLog::encode(std::vector<u8> &payload) const
+{
+    payload.clear();
+    write_varint(payload, edits.size());
+
+    u32 previous_index = 0;
+    for (const auto &edit : edits)
+    {
+        write_varint(payload, edit.index - previous_index);
+        payload.push_back(edit.type);
+        previous_index = edit.index;
+    }
+}
+
+void
+ChunkEditLog::diff(const BlockType generated[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                           [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                           [BlockStorage::NUM_BLOCKS_PER_AXIS],
+                   const BlockType blocks[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                        [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                        [BlockStorage::NUM_BLOCKS_PER_AXIS])
+{
+    const BlockType *flat_generated = &generated[0][0][0];
+    const BlockType *flat_blocks = &blocks[0][0][0];
+
+    // NOTE: Blocks are visited in index order, so the edits come out sorted.
+    edits.clear();
+    for (i32 i = 0; i < BlockStorage::NUM_BLOCKS; i++)
+    {
+        if (flat_blocks[i] != flat_generated[i])
+            edits.push_back(BlockEdit{(u16)i, flat_blocks[i]});
+    }
+}
+
+bool
+ChunkEditLog::decode(const u8 *payload, usize size)
+{
+    edits.clear();
+
+    usize position = 0;
+    u32 num_edits;
+    if (!read_varint(payload, size, position, num_edits) || num_edits > BlockStorage::NUM_BLOCKS)
+        return false;
+
+    edits.reserve(num_edits);
+
+    u32 index = 0;
+    for (u32 i = 0; i < num_edits; i++)
+    {
+        u32 delta;
+        if (!read_varint(payload, size, position, delta) || position >= size)
+            return false;
+
+        // NOTE: Edits are sorted and unique, so only the first delta can be zero.
+        index += delta;
+        const u8 type = payload[position++];
+        if ((i > 0 && delta == 0) || index >= BlockStorage::NUM_BLOCKS || type >= BlockType_Count)
+            return false;
+
+        edits.push_back(BlockEdit{(u16)index, static_cast<BlockType>(type)});
+    }
+
+    return position == size;
+}
+
+// ----------------------------------------------------------------------------------------------
+// FlushRegionsTask
+// ----------------------------------------------------------------------------------------------
+
+FlushRegionsTask::FlushRegionsTask(RegionStore *store)
+    : m_store(store)
+{
+    m_status = TaskStatus_Complete;
+}
+
+void
+FlushRegionsTask::run()
+{
+    m_status = TaskStatus_Processing;
+    m_store->flush();
+    m_status = TaskStatus_Complete;
+}
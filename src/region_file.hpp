@@ -0,0 +1,223 @@
+#ifndef __REGION_FILE_HPP__
+#define __REGION_FILE_HPP__
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "lt_core.hpp"
+#include "io_task.hpp"
+#include "block_storage.hpp"
+
+// Block of a chunk that was changed after the chunk was generated.
+struct BlockEdit
+{
+    // Index of the block, as (x*NUM_BLOCKS_PER_AXIS + y)*NUM_BLOCKS_PER_AXIS + z.
+    u16       index;
+    BlockType type;
+};
+
+// Edits of a chunk sorted by block index, with only the last edit of each block. Since the terrain
+// is generated from the seed alone, a chunk is rebuilt by generating it and applying its edits.
+struct ChunkEditLog
+{
+    void record(i32 x, i32 y, i32 z, BlockType type);
+    void apply(BlockType blocks[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                               [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                               [BlockStorage::NUM_BLOCKS_PER_AXIS]) const;
+
+    // Block offsets are stored as varint deltas from the previous edit, followed by the block type,
+    // so most edits take two bytes.
+    void encode(std::vector<u8> &payload) const;
+    bool decode(const u8 *payload, usize size);
+    // Replaces the edits by the blocks that differ between the generated blocks and the given ones.
+    void diff(const BlockType generated[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                       [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                       [BlockStorage::NUM_BLOCKS_PER_AXIS],
+              const BlockType blocks[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                    [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                    [BlockStorage::NUM_BLOCKS_PER_AXIS]);
+
+    inline bool empty() const { return edits.empty(); }
+    inline void clear() { edits.clear(); }
+
+    std::vector<BlockEdit> edits;
+};
+
+//
+// Edit logs of chunks saved to disk, grouped in region files of REGION_SIZE x REGION_SIZE columns
+// of chunks. Every region file starts with a table telling where the edits of each one of its
+// chunks are stored, so a single chunk can be read without reading the rest of the file.
+//
+// Saved chunks are kept in memory until flush writes them, which is meant to be called by
+// a FlushRegionsTask. Chunks can be loaded from any thread.
+//
+// Each open region has its own lock, which is the only one held while its file is opened, read or
+// written. The lock of the store only guards the chunks waiting to be written and which region is
+// kept in which slot, so loading a chunk never waits for the disk because of another region.
+//
+// Saved edits are appended to the file, and the old edits of the chunk are left where they were
+// until the file is compacted, so a file is valid at every step of a write.
+//
+// Version 1 files stored whole chunks instead of edits. They are still read, and the chunks are
+// turned into edits by comparing them with the generated terrain. Their table is converted in place
+// the first time a chunk of the region is written.
+//
+// Region files are never truncated. A file that is not a region file is renamed with a .bad
+// extension before a new one takes its place, and the chunks of a file written by a newer version
+// are kept in memory instead of being written.
+//
+struct RegionStore
+{
+    // Number of columns of chunks along x and z in a region.
+    constexpr static i32 REGION_SIZE = 8;
+    // Number of chunks along y in a column, the chunks above it cannot be saved.
+    constexpr static i32 MAX_CHUNKS_Y = 8;
+    constexpr static i32 NUM_REGION_CHUNKS = REGION_SIZE*REGION_SIZE*MAX_CHUNKS_Y;
+    constexpr static std::chrono::seconds FLUSH_RETRY_DELAY{5};
+
+    // The store keeps open every region of max_columns_per_axis columns around the center, plus
+    // one ring of regions around them.
+    RegionStore(const std::string &directory, i32 max_columns_per_axis);
+    ~RegionStore();
+
+    RegionStore(const RegionStore&) = delete;
+    RegionStore &operator=(const RegionStore&) = delete;
+
+    // Encodes the edits of the chunk, which are written to disk on the next flush.
+    // A chunk that was saved before and was not flushed yet is replaced.
+    void save_chunk(i32 column_x, i32 cy, i32 column_z, const ChunkEditLog &edits);
+    // Reads the edits of a saved chunk, returning false if the chunk was never saved. The generated
+    // blocks of the chunk are only looked at for chunks saved by version 1.
+    bool load_chunk(i32 column_x, i32 cy, i32 column_z,
+                    const BlockType generated[BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                             [BlockStorage::NUM_BLOCKS_PER_AXIS]
+                                             [BlockStorage::NUM_BLOCKS_PER_AXIS],
+                    ChunkEditLog &edits);
+    // Writes every saved chunk to its region file. Chunks that could not be written stay pending,
+    // unless they were saved again in the meantime.
+    void flush();
+    // True while some saved chunk is not written yet, including the chunks that failed to be written.
+    bool has_pending_chunks() const;
+    // True when flush has chunks to write. After a flush failed to write some chunks, they are only
+    // written again once FLUSH_RETRY_DELAY went by, so a region that cannot be written does not keep
+    // the io thread busy.
+    bool should_flush() const;
+
+private:
+    struct TableEntry
+    {
+        // Position of the encoded edits in the file, zero if the chunk was never saved.
+        u32 offset;
+        // Set with FULL_CHUNK_FLAG for chunks saved as whole blocks by version 1.
+        u32 size;
+    };
+
+    struct Region
+    {
+        // Region kept in the slot, guarded by the mutex of the store. A slot is only given to
+        // another region while nobody uses it, but its file is opened by its next user, so the
+        // open file can belong to the previous region for a while.
+        i32 region_x;
+        i32 region_z;
+        bool is_assigned;
+        i32 num_users;
+        u64 last_used;
+
+        // Everything below is guarded by the lock of the region.
+        std::shared_mutex mutex;
+        bool is_open;
+        i32 open_region_x;
+        i32 open_region_z;
+        // The file is only created when the first chunk of the region is written, until then
+        // the file descriptor is -1 and the table is empty.
+        int fd;
+        // Cleared when the file exists but cannot be used, e.g. it was written by a newer version.
+        // Its chunks are then never written, so the file is not replaced by one that lost them.
+        bool is_writable;
+        u32 version;
+        // The mapping always covers the whole file, so readers never have to map it again.
+        u8 *mapping;
+        usize mapped_size;
+        usize file_size;
+        TableEntry table[NUM_REGION_CHUNKS];
+    };
+
+    struct ChunkKey
+    {
+        i32 column_x;
+        i32 cy;
+        i32 column_z;
+
+        bool operator==(const ChunkKey &other) const
+        {
+            return column_x == other.column_x && cy == other.cy && column_z == other.column_z;
+        }
+    };
+
+    struct ChunkKeyHash
+    {
+        usize operator()(const ChunkKey &key) const
+        {
+            return ((usize)(u32)key.column_x * 73856093) ^ ((usize)(u32)key.cy * 19349663) ^
+                   ((usize)(u32)key.column_z * 83492791);
+        }
+    };
+
+    using ChunkPayloads = std::unordered_map<ChunkKey, std::vector<u8>, ChunkKeyHash>;
+
+    std::string region_path(i32 region_x, i32 region_z) const;
+    // Returns the slot of the region locked, shared or exclusive, with the file of the region open
+    // if it exists. A file that could not be opened is tried again the next time the region is
+    // locked. The store mutex should not be held by the caller.
+    Region &lock_region(i32 region_x, i32 region_z, bool exclusive);
+    void unlock_region(Region &region, bool exclusive);
+    // The lock of the region should be held exclusively by the caller of the functions below.
+    void open_region(Region &region, i32 region_x, i32 region_z);
+    void close_region(Region &region);
+    // Maps the whole file again after it grew.
+    bool map_region(Region &region);
+    // Rewrites the file with only the edits its table points to, once the old edits left behind
+    // by the chunks saved again take more room than them. The file should be mapped.
+    void compact_region(Region &region);
+    bool write_chunk(Region &region, const ChunkKey &key, const std::vector<u8> &payload);
+
+    std::string m_directory;
+    // Encoded edits of the chunks waiting to be written.
+    ChunkPayloads m_pending_chunks;
+    // Chunks being written by flush, which stay readable until they are in their region file.
+    // Only flush changes it, so flush reads the payloads without the lock.
+    ChunkPayloads m_flushing_chunks;
+    // Slots of the region files kept open and mapped at the same time.
+    std::unique_ptr<Region[]> m_regions;
+    i32 m_num_regions;
+    u64 m_num_region_uses;
+    // When the last flush failed to write some chunks, guarded by the mutex of the store.
+    bool m_has_failed_chunks;
+    std::chrono::steady_clock::time_point m_last_failure;
+    std::mutex mutable m_mutex;
+    // Signaled when a slot is not used anymore, for threads that found every slot in use.
+    std::condition_variable m_region_released;
+    // Keeps two flushes from writing the same chunks.
+    std::mutex m_flush_mutex;
+};
+
+// Writes the chunks saved in a region store. The task can be queued again once it is complete.
+struct FlushRegionsTask : IOTask
+{
+    explicit FlushRegionsTask(RegionStore *store);
+
+    // Should be called before adding the task to the queue, so the task is not queued twice.
+    void set_queued() { m_status = TaskStatus_Processing; }
+
+    void run() override;
+
+private:
+    RegionStore *m_store;
+};
+
+#endif // __REGION_FILE_HPP__
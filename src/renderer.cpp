@@ -36,20 +36,73 @@ render_mesh(const Mesh &mesh, Shader *shader)
 }
 
 void
-render_landscape(World &world)
+render_landscape(World &world, Shader *shader, bool skip_directions_facing_away)
 {
-    // Assuming that every chunk uses the same shader program.
-    for (i32 i = 0; i < Landscape::NUM_CHUNKS; i++)
-    {
-        const auto &vao_array = world.landscape->vao_array;
+    // Assuming that every chunk uses the same shader program, which should already be in use.
+    const u32 chunk_origin_location = shader->location("chunk_origin");
+    const auto &vao_array = world.landscape->vao_array;
+    const Vec3f eye = world.camera.position();
 
-        auto entry = vao_array.vaos[i];
-        if (entry.is_used && entry.num_vertices_used > 0)
+    for (i32 i = 0; i < Landscape::MAX_CHUNKS_IN_VIEW; i++)
+    {
+        const auto &entry = vao_array.vaos[i];
+        if (entry.is_used && entry.num_quads > 0)
         {
             LT_Assert(entry.vao != 0); // The vao should already be created.
 
+            glUniform3f(chunk_origin_location, entry.origin.x, entry.origin.y, entry.origin.z);
             glBindVertexArray(entry.vao);
-            glDrawArrays(GL_TRIANGLES, 0, entry.num_vertices_used);
+
+            if (!skip_directions_facing_away || !entry.is_sorted_by_face)
+            {
+                glDrawElements(GL_TRIANGLES, entry.num_quads * 6, GL_UNSIGNED_INT, nullptr);
+                glBindVertexArray(0);
+                continue;
+            }
+
+            // The faces of a direction can only be turned to the camera if the camera is in front
+            // of at least one of the planes where they lie, which are inside of the chunk bounds.
+            const Vec3f min = entry.origin;
+            const Vec3f max = entry.origin + Vec3f(Landscape::Chunk::SIZE);
+            const bool is_direction_visible[BlockFace_Count] = {
+                eye.x < max.x, // Left
+                eye.x > min.x, // Right
+                eye.y > min.y, // Top
+                eye.y < max.y, // Bottom
+                eye.z > min.z, // Front
+                eye.z < max.z, // Back
+            };
+
+            // Visible directions that are next to each other in the buffer are drawn as one range.
+            GLsizei counts[BlockFace_Count];
+            const void *offsets[BlockFace_Count];
+            i32 num_ranges = 0;
+            u32 first_quad = 0;
+            u32 range_end = 0;
+
+            for (i32 face = 0; face < BlockFace_Count; face++)
+            {
+                const u32 num_quads = entry.face_num_quads[face];
+                if (is_direction_visible[face] && num_quads > 0)
+                {
+                    if (num_ranges > 0 && range_end == first_quad)
+                    {
+                        counts[num_ranges-1] += num_quads * 6;
+                    }
+                    else
+                    {
+                        counts[num_ranges] = num_quads * 6;
+                        offsets[num_ranges] = (const void*)(sizeof(u32) * 6 * first_quad);
+                        num_ranges++;
+                    }
+                    range_end = first_quad + num_quads;
+                }
+                first_quad += num_quads;
+            }
+            LT_Assert(first_quad == entry.num_quads);
+
+            if (num_ranges > 0)
+                glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, num_ranges);
             glBindVertexArray(0);
         }
     }
@@ -15,7 +15,8 @@ struct Vertex_PUC;
 struct ResourceManager;
 struct Frustum;
 
-void render_landscape(World &world);
+// Chunk faces pointing away from the camera are not drawn when skip_directions_facing_away is true.
+void render_landscape(World &world, Shader *shader, bool skip_directions_facing_away);
 void render_skybox(const Skybox &skybox);
 void render_text(AsciiFontAtlas *atlas, const std::string &text, f32 posx, f32 posy, Shader *shader);
 void render_loading_screen(const Application &app, AsciiFontAtlas *atlas, Shader *font_shader);
@@ -35,6 +35,8 @@ struct ResourceManager
     AsciiFontAtlas *get_font(const std::string &filename) const;
     void free_all_resources();
 
+    inline IOTaskManager *io_task_manager() const { return m_io_task_manager; }
+
 private:
     IOTaskManager *m_io_task_manager;
     std::string m_shaders_path;
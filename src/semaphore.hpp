@@ -3,12 +3,15 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 
 #include "lt_core.hpp"
 
-struct Semaphore
+// Semaphore that always goes through a mutex and a condition variable.
+struct BlockingSemaphore
 {
-    Semaphore() : m_count(0) {}
+    BlockingSemaphore() : m_count(0) {}
 
     inline void notify()
     {
@@ -38,4 +41,52 @@ private:
     u32 m_count;
 };
 
+//
+// Semaphore that only touches the blocking semaphore when a thread has to sleep. The count is
+// kept in an atomic, negative while threads are waiting, so notifying a semaphore that nobody waits
+// for is a single atomic add. Before sleeping, a waiting thread spins for a short time, since work
+// usually arrives in bursts and the next notify is likely to come soon.
+//
+struct Semaphore
+{
+    constexpr static i32 MAX_SPINS = 1024;
+
+    Semaphore() : m_count(0) {}
+
+    inline void notify()
+    {
+        notify_all(1);
+    }
+
+    inline void notify_all(i32 count = 1)
+    {
+        LT_Assert(count > 0);
+        const i32 old_count = m_count.fetch_add(count, std::memory_order_release);
+        // NOTE: Only the threads that went to sleep are woken up, the others see the new count.
+        const i32 num_sleeping = std::min(-old_count, count);
+        for (i32 i = 0; i < num_sleeping; i++)
+            m_sleeping.notify();
+    }
+
+    inline void wait()
+    {
+        for (i32 spin = 0; spin < MAX_SPINS; spin++)
+        {
+            i32 count = m_count.load(std::memory_order_relaxed);
+            if (count > 0 && m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire,
+                                                           std::memory_order_relaxed))
+                return;
+            // Tell the compiler the value can change, without paying for a full fence.
+            std::atomic_signal_fence(std::memory_order_acquire);
+        }
+
+        if (m_count.fetch_sub(1, std::memory_order_acquire) <= 0)
+            m_sleeping.wait();
+    }
+
+private:
+    std::atomic<i32>  m_count;
+    BlockingSemaphore m_sleeping;
+};
+
 #endif // __SEMAPHORE_HPP__
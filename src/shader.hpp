@@ -32,6 +32,10 @@ struct Shader
 
     void use() const;
 
+    // Location of a uniform, useful for setting the same uniform many times without
+    // going through the name lookup.
+    inline u32 location(const char *name) { return get_location(name); }
+
     void debug_validate() const;
 
 private:
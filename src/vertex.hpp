@@ -1,7 +1,9 @@
 #ifndef __VERTEX_HPP__
 #define __VERTEX_HPP__
 
+#include <vector>
 #include "lt_math.hpp"
+#include "counting_allocator.hpp"
 
 //
 // Suffixes:
@@ -54,4 +56,26 @@ struct Vertex_PLN
     Vec3f normal           = Vec3f(0.0f);
 };
 
+//
+// Packed vertex used by the landscape chunks. Positions are relative to the chunk origin,
+// which is set as a uniform, and the normal is implied by the face direction (BlockFace).
+// The vertices are always drawn as quads of 4 with a shared index buffer.
+//
+struct Vertex_Chunk
+{
+    u8  x, y, z;
+    u8  face;
+    u8  u, v;    // texture coordinates, in blocks
+    u16 layer;   // layer in the texture array
+
+    Vertex_Chunk(Vec3i p, u8 face, u8 u, u8 v, u16 layer)
+        : x(p.x), y(p.y), z(p.z), face(face), u(u), v(v), layer(layer) {}
+    Vertex_Chunk() : x(0), y(0), z(0), face(0), u(0), v(0), layer(0) {}
+};
+static_assert(sizeof(Vertex_Chunk) == 8, "Vertex_Chunk should be tightly packed");
+
+// Every allocation of chunk vertices goes through this counter, wherever the buffer lives.
+inline AllocationCounter g_chunk_vertex_allocations;
+using ChunkVertexBuffer = std::vector<Vertex_Chunk, CountingAllocator<Vertex_Chunk, g_chunk_vertex_allocations>>;
+
 #endif // __VERTEX_HPP__
@@ -41,7 +41,7 @@ World::World(Application &app, i32 seed, const char *textures_16x16_name,
     const f64 lacunarity = 2.0f;
     const f64 gain = 0.5f;
 
-    landscape = std::make_shared<Landscape>(app.memory, seed, amplitude,
+    landscape = std::make_shared<Landscape>(app.memory, manager.io_task_manager(), seed, amplitude,
                                             frequency, num_octaves, lacunarity, gain);
     landscape->generate();
 
@@ -50,7 +50,7 @@ World::World(Application &app, i32 seed, const char *textures_16x16_name,
     sun.ambient = Vec3f(.1f);
     sun.diffuse = Vec3f(.7f);
     sun.specular = Vec3f(1.0f);
-    sun.position = landscape->origin + Vec3f(0.0f, 300.0f, 0.0f);
+    sun.update_position(landscape->center());
     sun.direction = lt::normalize(Vec3f(0.5f, -1.0f, 0.5f));
 		sun.projection = lt::orthographic(-200, 200, -200, 200, 1.0f, 800.0f);
 }
@@ -85,7 +85,7 @@ World::update(Input &input, ShadowMap &shadow_map, Shader *basic_shader)
         camera.update(input);
 
         landscape->update(camera, input);
-        sun.update_position(landscape->origin);
+        sun.update_position(landscape->center());
 
         const Mat4f light_space = sun.light_space();
 
@@ -169,8 +169,8 @@ Crosshair::Crosshair(const char *shader_name, const ResourceManager &manager, u3
 // ======================================================================================
 
 void
-Sun::update_position(Vec3f landscape_origin)
+Sun::update_position(Vec3f landscape_center)
 {
-    position = landscape_origin; //+ 0.5f*Vec3f(Landscape::SIZE_X, 1000.0f, Landscape::SIZE_Z);
-    position.y += 300.0f;
+    position = landscape_center;
+    position.y = 300.0f;
 }
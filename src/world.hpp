@@ -51,7 +51,7 @@ struct Sun
     Vec3f position;
     Mat4f projection;
 
-    void update_position(Vec3f landscape_origin);
+    void update_position(Vec3f landscape_center);
 
     inline Mat4f light_space() const
     {
@@ -0,0 +1,22 @@
+#ifndef __WORLD_COORDINATES_HPP__
+#define __WORLD_COORDINATES_HPP__
+
+#include "lt_core.hpp"
+
+// Integer division and modulo rounding towards minus infinity, for coordinates around the world origin,
+// where truncating would put the blocks, chunks or regions on both sides of zero together.
+inline i32
+floor_div(i32 a, i32 b)
+{
+    const i32 quotient = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? quotient - 1 : quotient;
+}
+
+inline i32
+floor_mod(i32 a, i32 b)
+{
+    const i32 remainder = a % b;
+    return (remainder != 0 && (remainder < 0) != (b < 0)) ? remainder + b : remainder;
+}
+
+#endif // __WORLD_COORDINATES_HPP__
@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include <errno.h>
 
 #include "open-simplex-noise.h"
@@ -347,6 +350,281 @@ double open_simplex_noise2(struct osn_context *ctx, double x, double y)
 	return value / NORM_CONSTANT_2D;
 }
 
+/*
+ * Batch 2D noise.
+ *
+ * The points are evaluated a few at a time in SSE2 lanes. Both sides of every branch of
+ * open_simplex_noise2 are computed and the results are selected with masks, while the
+ * permutation lookups are done one lane at a time. The double precision version performs
+ * exactly the same floating point operations as open_simplex_noise2, so its results are the same.
+ */
+#if defined(__SSE2__)
+
+/* mask ? a : b */
+static INLINE __m128d blend_pd(__m128d mask, __m128d a, __m128d b)
+{
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+static INLINE __m128 blend_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/* Same as fastFloor, with the result kept as a floating point number. */
+static INLINE __m128d fast_floor_pd(__m128d x)
+{
+	__m128d xi = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+	return _mm_sub_pd(xi, _mm_and_pd(_mm_cmplt_pd(x, xi), _mm_set1_pd(1.0)));
+}
+
+static INLINE __m128 fast_floor_ps(__m128 x)
+{
+	__m128 xi = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(xi, _mm_and_ps(_mm_cmplt_ps(x, xi), _mm_set1_ps(1.0f)));
+}
+
+static INLINE __m128d extrapolate2_pd(struct osn_context *ctx, __m128d xsb, __m128d ysb, __m128d dx, __m128d dy)
+{
+	int16_t *perm = ctx->perm;
+	double xsbs[2], ysbs[2], gx[2], gy[2];
+	int i;
+
+	_mm_storeu_pd(xsbs, xsb);
+	_mm_storeu_pd(ysbs, ysb);
+	for (i = 0; i < 2; i++) {
+		int index = perm[(perm[(int) xsbs[i] & 0xFF] + (int) ysbs[i]) & 0xFF] & 0x0E;
+		gx[i] = gradients2D[index];
+		gy[i] = gradients2D[index + 1];
+	}
+	return _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(gx), dx), _mm_mul_pd(_mm_loadu_pd(gy), dy));
+}
+
+static INLINE __m128 extrapolate2_ps(struct osn_context *ctx, __m128 xsb, __m128 ysb, __m128 dx, __m128 dy)
+{
+	int16_t *perm = ctx->perm;
+	int32_t xsbs[4], ysbs[4];
+	float gx[4], gy[4];
+	int i;
+
+	_mm_storeu_si128((__m128i *) xsbs, _mm_cvttps_epi32(xsb));
+	_mm_storeu_si128((__m128i *) ysbs, _mm_cvttps_epi32(ysb));
+	for (i = 0; i < 4; i++) {
+		int index = perm[(perm[xsbs[i] & 0xFF] + ysbs[i]) & 0xFF] & 0x0E;
+		gx[i] = gradients2D[index];
+		gy[i] = gradients2D[index + 1];
+	}
+	return _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(gx), dx), _mm_mul_ps(_mm_loadu_ps(gy), dy));
+}
+
+/* Adds the contribution of one lattice vertex to value, for the lanes where the vertex is in range. */
+static INLINE __m128d contribution2_pd(struct osn_context *ctx, __m128d value, __m128d xsv, __m128d ysv, __m128d dx, __m128d dy)
+{
+	__m128d attn = _mm_sub_pd(_mm_sub_pd(_mm_set1_pd(2.0), _mm_mul_pd(dx, dx)), _mm_mul_pd(dy, dy));
+	__m128d in_range = _mm_cmpgt_pd(attn, _mm_setzero_pd());
+	attn = _mm_mul_pd(attn, attn);
+	__m128d contribution = _mm_mul_pd(_mm_mul_pd(attn, attn), extrapolate2_pd(ctx, xsv, ysv, dx, dy));
+	return blend_pd(in_range, _mm_add_pd(value, contribution), value);
+}
+
+static INLINE __m128 contribution2_ps(struct osn_context *ctx, __m128 value, __m128 xsv, __m128 ysv, __m128 dx, __m128 dy)
+{
+	__m128 attn = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(dx, dx)), _mm_mul_ps(dy, dy));
+	__m128 in_range = _mm_cmpgt_ps(attn, _mm_setzero_ps());
+	attn = _mm_mul_ps(attn, attn);
+	__m128 contribution = _mm_mul_ps(_mm_mul_ps(attn, attn), extrapolate2_ps(ctx, xsv, ysv, dx, dy));
+	return blend_ps(in_range, _mm_add_ps(value, contribution), value);
+}
+
+static __m128d open_simplex_noise2_pd(struct osn_context *ctx, __m128d x, __m128d y)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d squish = _mm_set1_pd(SQUISH_CONSTANT_2D);
+	const __m128d squish2 = _mm_set1_pd(2 * SQUISH_CONSTANT_2D);
+
+	/* Place input coordinates onto grid. */
+	__m128d stretchOffset = _mm_mul_pd(_mm_add_pd(x, y), _mm_set1_pd(STRETCH_CONSTANT_2D));
+	__m128d xs = _mm_add_pd(x, stretchOffset);
+	__m128d ys = _mm_add_pd(y, stretchOffset);
+
+	/* Floor to get grid coordinates of rhombus (stretched square) super-cell origin. */
+	__m128d xsb = fast_floor_pd(xs);
+	__m128d ysb = fast_floor_pd(ys);
+
+	/* Skew out to get actual coordinates of rhombus origin. */
+	__m128d squishOffset = _mm_mul_pd(_mm_add_pd(xsb, ysb), squish);
+	__m128d xb = _mm_add_pd(xsb, squishOffset);
+	__m128d yb = _mm_add_pd(ysb, squishOffset);
+
+	/* Compute grid coordinates relative to rhombus origin. */
+	__m128d xins = _mm_sub_pd(xs, xsb);
+	__m128d yins = _mm_sub_pd(ys, ysb);
+	__m128d inSum = _mm_add_pd(xins, yins);
+
+	/* Positions relative to origin point. */
+	__m128d dx0 = _mm_sub_pd(x, xb);
+	__m128d dy0 = _mm_sub_pd(y, yb);
+
+	__m128d value = zero;
+
+	/* Contribution (1,0) */
+	value = contribution2_pd(ctx, value, _mm_add_pd(xsb, one), ysb,
+	                         _mm_sub_pd(_mm_sub_pd(dx0, one), squish), _mm_sub_pd(_mm_sub_pd(dy0, zero), squish));
+
+	/* Contribution (0,1) */
+	value = contribution2_pd(ctx, value, xsb, _mm_add_pd(ysb, one),
+	                         _mm_sub_pd(_mm_sub_pd(dx0, zero), squish), _mm_sub_pd(_mm_sub_pd(dy0, one), squish));
+
+	__m128d x_greater = _mm_cmpgt_pd(xins, yins);
+
+	/* Extra vertex when inside the triangle (2-Simplex) at (0,0) */
+	__m128d zins_low = _mm_sub_pd(one, inSum);
+	__m128d low_closest = _mm_or_pd(_mm_cmpgt_pd(zins_low, xins), _mm_cmpgt_pd(zins_low, yins));
+	__m128d low_xsv = blend_pd(low_closest, blend_pd(x_greater, _mm_add_pd(xsb, one), _mm_sub_pd(xsb, one)), _mm_add_pd(xsb, one));
+	__m128d low_ysv = blend_pd(low_closest, blend_pd(x_greater, _mm_sub_pd(ysb, one), _mm_add_pd(ysb, one)), _mm_add_pd(ysb, one));
+	__m128d low_dx = blend_pd(low_closest, blend_pd(x_greater, _mm_sub_pd(dx0, one), _mm_add_pd(dx0, one)),
+	                          _mm_sub_pd(_mm_sub_pd(dx0, one), squish2));
+	__m128d low_dy = blend_pd(low_closest, blend_pd(x_greater, _mm_add_pd(dy0, one), _mm_sub_pd(dy0, one)),
+	                          _mm_sub_pd(_mm_sub_pd(dy0, one), squish2));
+
+	/* Extra vertex when inside the triangle (2-Simplex) at (1,1) */
+	__m128d zins_high = _mm_sub_pd(two, inSum);
+	__m128d high_closest = _mm_or_pd(_mm_cmplt_pd(zins_high, xins), _mm_cmplt_pd(zins_high, yins));
+	__m128d high_xsv = blend_pd(high_closest, blend_pd(x_greater, _mm_add_pd(xsb, two), xsb), xsb);
+	__m128d high_ysv = blend_pd(high_closest, blend_pd(x_greater, ysb, _mm_add_pd(ysb, two)), ysb);
+	__m128d high_dx = blend_pd(high_closest, blend_pd(x_greater, _mm_sub_pd(_mm_sub_pd(dx0, two), squish2),
+	                                                  _mm_sub_pd(_mm_add_pd(dx0, zero), squish2)), dx0);
+	__m128d high_dy = blend_pd(high_closest, blend_pd(x_greater, _mm_sub_pd(_mm_add_pd(dy0, zero), squish2),
+	                                                  _mm_sub_pd(_mm_sub_pd(dy0, two), squish2)), dy0);
+
+	__m128d is_low = _mm_cmple_pd(inSum, one);
+	__m128d xsv_ext = blend_pd(is_low, low_xsv, high_xsv);
+	__m128d ysv_ext = blend_pd(is_low, low_ysv, high_ysv);
+	__m128d dx_ext = blend_pd(is_low, low_dx, high_dx);
+	__m128d dy_ext = blend_pd(is_low, low_dy, high_dy);
+
+	/* Inside the triangle at (1,1) the base vertex moves to (1,1). */
+	xsb = blend_pd(is_low, xsb, _mm_add_pd(xsb, one));
+	ysb = blend_pd(is_low, ysb, _mm_add_pd(ysb, one));
+	dx0 = blend_pd(is_low, dx0, _mm_sub_pd(_mm_sub_pd(dx0, one), squish2));
+	dy0 = blend_pd(is_low, dy0, _mm_sub_pd(_mm_sub_pd(dy0, one), squish2));
+
+	/* Contribution (0,0) or (1,1) */
+	value = contribution2_pd(ctx, value, xsb, ysb, dx0, dy0);
+
+	/* Extra Vertex */
+	value = contribution2_pd(ctx, value, xsv_ext, ysv_ext, dx_ext, dy_ext);
+
+	return _mm_div_pd(value, _mm_set1_pd(NORM_CONSTANT_2D));
+}
+
+static __m128 open_simplex_noise2_ps(struct osn_context *ctx, __m128 x, __m128 y)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 squish = _mm_set1_ps((float) SQUISH_CONSTANT_2D);
+	const __m128 squish2 = _mm_set1_ps((float) (2 * SQUISH_CONSTANT_2D));
+
+	__m128 stretchOffset = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps((float) STRETCH_CONSTANT_2D));
+	__m128 xs = _mm_add_ps(x, stretchOffset);
+	__m128 ys = _mm_add_ps(y, stretchOffset);
+
+	__m128 xsb = fast_floor_ps(xs);
+	__m128 ysb = fast_floor_ps(ys);
+
+	__m128 squishOffset = _mm_mul_ps(_mm_add_ps(xsb, ysb), squish);
+	__m128 xb = _mm_add_ps(xsb, squishOffset);
+	__m128 yb = _mm_add_ps(ysb, squishOffset);
+
+	__m128 xins = _mm_sub_ps(xs, xsb);
+	__m128 yins = _mm_sub_ps(ys, ysb);
+	__m128 inSum = _mm_add_ps(xins, yins);
+
+	__m128 dx0 = _mm_sub_ps(x, xb);
+	__m128 dy0 = _mm_sub_ps(y, yb);
+
+	__m128 value = _mm_setzero_ps();
+
+	value = contribution2_ps(ctx, value, _mm_add_ps(xsb, one), ysb,
+	                         _mm_sub_ps(_mm_sub_ps(dx0, one), squish), _mm_sub_ps(dy0, squish));
+	value = contribution2_ps(ctx, value, xsb, _mm_add_ps(ysb, one),
+	                         _mm_sub_ps(dx0, squish), _mm_sub_ps(_mm_sub_ps(dy0, one), squish));
+
+	__m128 x_greater = _mm_cmpgt_ps(xins, yins);
+
+	__m128 zins_low = _mm_sub_ps(one, inSum);
+	__m128 low_closest = _mm_or_ps(_mm_cmpgt_ps(zins_low, xins), _mm_cmpgt_ps(zins_low, yins));
+	__m128 low_xsv = blend_ps(low_closest, blend_ps(x_greater, _mm_add_ps(xsb, one), _mm_sub_ps(xsb, one)), _mm_add_ps(xsb, one));
+	__m128 low_ysv = blend_ps(low_closest, blend_ps(x_greater, _mm_sub_ps(ysb, one), _mm_add_ps(ysb, one)), _mm_add_ps(ysb, one));
+	__m128 low_dx = blend_ps(low_closest, blend_ps(x_greater, _mm_sub_ps(dx0, one), _mm_add_ps(dx0, one)),
+	                         _mm_sub_ps(_mm_sub_ps(dx0, one), squish2));
+	__m128 low_dy = blend_ps(low_closest, blend_ps(x_greater, _mm_add_ps(dy0, one), _mm_sub_ps(dy0, one)),
+	                         _mm_sub_ps(_mm_sub_ps(dy0, one), squish2));
+
+	__m128 zins_high = _mm_sub_ps(two, inSum);
+	__m128 high_closest = _mm_or_ps(_mm_cmplt_ps(zins_high, xins), _mm_cmplt_ps(zins_high, yins));
+	__m128 high_xsv = blend_ps(high_closest, blend_ps(x_greater, _mm_add_ps(xsb, two), xsb), xsb);
+	__m128 high_ysv = blend_ps(high_closest, blend_ps(x_greater, ysb, _mm_add_ps(ysb, two)), ysb);
+	__m128 high_dx = blend_ps(high_closest, blend_ps(x_greater, _mm_sub_ps(_mm_sub_ps(dx0, two), squish2),
+	                                                 _mm_sub_ps(dx0, squish2)), dx0);
+	__m128 high_dy = blend_ps(high_closest, blend_ps(x_greater, _mm_sub_ps(dy0, squish2),
+	                                                 _mm_sub_ps(_mm_sub_ps(dy0, two), squish2)), dy0);
+
+	__m128 is_low = _mm_cmple_ps(inSum, one);
+	__m128 xsv_ext = blend_ps(is_low, low_xsv, high_xsv);
+	__m128 ysv_ext = blend_ps(is_low, low_ysv, high_ysv);
+	__m128 dx_ext = blend_ps(is_low, low_dx, high_dx);
+	__m128 dy_ext = blend_ps(is_low, low_dy, high_dy);
+
+	xsb = blend_ps(is_low, xsb, _mm_add_ps(xsb, one));
+	ysb = blend_ps(is_low, ysb, _mm_add_ps(ysb, one));
+	dx0 = blend_ps(is_low, dx0, _mm_sub_ps(_mm_sub_ps(dx0, one), squish2));
+	dy0 = blend_ps(is_low, dy0, _mm_sub_ps(_mm_sub_ps(dy0, one), squish2));
+
+	value = contribution2_ps(ctx, value, xsb, ysb, dx0, dy0);
+	value = contribution2_ps(ctx, value, xsv_ext, ysv_ext, dx_ext, dy_ext);
+
+	return _mm_div_ps(value, _mm_set1_ps((float) NORM_CONSTANT_2D));
+}
+
+void open_simplex_noise2_batch(struct osn_context *ctx, const double *x, const double *y, double *out, int count)
+{
+	int i = 0;
+	for (; i + 2 <= count; i += 2)
+		_mm_storeu_pd(out + i, open_simplex_noise2_pd(ctx, _mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+	for (; i < count; i++)
+		out[i] = open_simplex_noise2(ctx, x[i], y[i]);
+}
+
+void open_simplex_noise2_batch_f32(struct osn_context *ctx, const float *x, const float *y, float *out, int count)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(out + i, open_simplex_noise2_ps(ctx, _mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+	for (; i < count; i++)
+		out[i] = (float) open_simplex_noise2(ctx, x[i], y[i]);
+}
+
+#else
+
+void open_simplex_noise2_batch(struct osn_context *ctx, const double *x, const double *y, double *out, int count)
+{
+	int i;
+	for (i = 0; i < count; i++)
+		out[i] = open_simplex_noise2(ctx, x[i], y[i]);
+}
+
+void open_simplex_noise2_batch_f32(struct osn_context *ctx, const float *x, const float *y, float *out, int count)
+{
+	int i;
+	for (i = 0; i < count; i++)
+		out[i] = (float) open_simplex_noise2(ctx, x[i], y[i]);
+}
+
+#endif
+
 /*
  * 3D OpenSimplex (Simplectic) Noise
  */
@@ -41,6 +41,12 @@ int open_simplex_noise(int64_t seed, struct osn_context **ctx);
 void open_simplex_noise_free(struct osn_context *ctx);
 int open_simplex_noise_init_perm(struct osn_context *ctx, int16_t p[], int nelements);
 double open_simplex_noise2(struct osn_context *ctx, double x, double y);
+/*
+ * Evaluates the 2D noise at count points, giving the same results as open_simplex_noise2.
+ * The single precision version is faster, but its results differ slightly.
+ */
+void open_simplex_noise2_batch(struct osn_context *ctx, const double *x, const double *y, double *out, int count);
+void open_simplex_noise2_batch_f32(struct osn_context *ctx, const float *x, const float *y, float *out, int count);
 double open_simplex_noise3(struct osn_context *ctx, double x, double y, double z);
 double open_simplex_noise4(struct osn_context *ctx, double x, double y, double z, double w);
 